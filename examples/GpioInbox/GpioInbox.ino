@@ -0,0 +1,80 @@
+#include <SwarmTile.h>
+
+/*
+ * GpioInbox
+ *
+ * This sketch configures the Tile to signal pending received messages on its GPIO1 pin.
+ * Instead of asking the Tile over serial every few seconds, the sketch only reads the
+ * inbox when GPIO1 indicates that messages are waiting. The interrupt handler can be
+ * used to wake the MCU from a low power mode.
+ *
+ * The sketch assumes that the tile is connected to Serial1 and that Tile GPIO1 is
+ * wired to pin 2 of the MCU. Change this as needed.
+ */
+
+#define TileSerial Serial1  // serial port connected to the tile
+#define TILE_GPIO_PIN 2     // MCU pin connected to Tile GPIO1, must support interrupts
+
+// Declare the Tile object
+SwarmTile tile(TileSerial);
+
+// Set by interrupt handler when the Tile signals pending messages
+volatile bool inboxSignalled = false;
+
+void onInbox()
+{
+  inboxSignalled = true;
+}
+
+void setup()
+{
+  tile_status_t result;
+
+  Serial.begin(9600);
+  TileSerial.begin(115200);
+
+  Serial.print("Starting Swarm Tile...");
+  tile.begin();
+  while (!tile.isReady()) {
+    Serial.print(".");
+    delay(2000);
+  };
+  Serial.println("done!");
+
+  // Example: Let the Tile drive GPIO1 high while received messages are pending.
+  result = tile.attachGpioPin(TILE_GPIO_PIN, TILE_GPIO_MSG_PENDING_HIGH, onInbox);
+  if (result != TILE_SUCCESS) {
+    Serial.print("attachGpioPin failed: ");
+    Serial.println(result);
+    return;
+  }
+
+  // messages may already be waiting from before we attached the interrupt
+  inboxSignalled = tile.isGpioActive();
+}
+
+void loop()
+{
+  if (!inboxSignalled) {
+    // Nothing to do. Put the MCU into a low power mode here, the interrupt
+    // will wake it up when the Tile receives a message.
+    delay(100);
+    return;
+  }
+  inboxSignalled = false;
+
+  // Example: Read received messages while GPIO1 indicates pending messages.
+  // hasUnreadMessages() only talks to the Tile when GPIO1 is active.
+  while (tile.hasUnreadMessages()) {
+    char buffer[192];
+    uint16_t msg_len = tile.readMessage(buffer, sizeof(buffer));
+    if (msg_len == 0) {
+      break;
+    }
+    Serial.print("Message received! Length: ");
+    Serial.print(msg_len);
+    Serial.println(" bytes");
+  }
+
+  tile.deleteReadMsgs();
+}
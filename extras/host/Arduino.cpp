@@ -0,0 +1,75 @@
+#include "Arduino.h"
+#include <time.h>
+#include <errno.h>
+
+// monotonic, unlike wall clock time it doesn't jump when the gateway syncs its clock
+unsigned long millis()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void delay(unsigned long ms)
+{
+    struct timespec req;
+    req.tv_sec = ms / 1000;
+    req.tv_nsec = (ms % 1000) * 1000000L;
+    while (nanosleep(&req, &req) != 0 && errno == EINTR) {
+        // resume after signal
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    return LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode)
+{
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+}
+
+extern "C" {
+char* ultoa(unsigned long value, char *string, int radix)
+{
+    char tmp[sizeof(unsigned long) * 8 + 1];
+    char *tp = tmp;
+    char *sp;
+
+    if (string == NULL || radix > 36 || radix <= 1) {
+        return 0;
+    }
+
+    do {
+        unsigned long i = value % radix;
+        value /= radix;
+        *tp++ = i < 10 ? i + '0' : i + 'a' - 10;
+    } while (value);
+
+    sp = string;
+    while (tp > tmp) {
+        *sp++ = *--tp;
+    }
+    *sp = 0;
+
+    return string;
+}
+
+char* ltoa(long value, char *string, int radix)
+{
+    if (string != NULL && value < 0 && radix == 10) {
+        string[0] = '-';
+        ultoa(-(unsigned long) value, string + 1, radix);
+        return string;
+    }
+    return ultoa(value, string, radix);
+}
+}
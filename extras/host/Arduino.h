@@ -0,0 +1,37 @@
+
+#ifndef _ARDUINO_H
+#define _ARDUINO_H
+
+// minimal Arduino API to build the library on Linux hosts
+
+#include <inttypes.h>
+#include <cstring>
+
+#define PROGMEM
+#define F(str) (str)
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define digitalPinToInterrupt(p) (p)
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+// hosts have no GPIO wired to the Tile, pins read LOW and interrupts never fire
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+extern "C" {
+char* ltoa(long value, char *string, int radix);
+char* ultoa(unsigned long value, char *string, int radix);
+}
+
+#endif
@@ -0,0 +1,75 @@
+
+#include "HostFile.h"
+
+HostFile::HostFile()
+{
+    _file = 0;
+    _owned = false;
+}
+
+HostFile::~HostFile()
+{
+    end();
+}
+
+bool HostFile::begin(const char *path, bool append)
+{
+    end();
+    _file = fopen(path, append ? "a" : "w");
+    _owned = true;
+    return _file != 0;
+}
+
+bool HostFile::begin(FILE *file)
+{
+    end();
+    _file = file;
+    _owned = false;
+    return _file != 0;
+}
+
+void HostFile::end()
+{
+    if (_file && _owned) {
+        fclose(_file);
+    }
+    _file = 0;
+}
+
+int HostFile::available()
+{
+    return 0;
+}
+
+int HostFile::read()
+{
+    return -1;
+}
+
+int HostFile::peek()
+{
+    return -1;
+}
+
+size_t HostFile::write(uint8_t ch)
+{
+    if (!_file || fputc(ch, _file) == EOF) {
+        return 0;
+    }
+    return 1;
+}
+
+size_t HostFile::write(const uint8_t *buffer, size_t size)
+{
+    if (!_file) {
+        return 0;
+    }
+    return fwrite(buffer, 1, size, _file);
+}
+
+void HostFile::flush()
+{
+    if (_file) {
+        fflush(_file);
+    }
+}
@@ -0,0 +1,32 @@
+
+#ifndef _HOST_FILE_H
+#define _HOST_FILE_H
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "Stream.h"
+
+// write-only Stream into a file, e.g. for recording traces with SwarmTile::setDebugStream
+class HostFile : public Stream
+{
+public:
+    HostFile();
+    ~HostFile();
+
+    bool begin(const char *path, bool append = false);     // returns false on error
+    bool begin(FILE *file);                                 // uses open file, e.g. stderr, without closing it
+    void end();
+
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual size_t write(uint8_t ch);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual void flush();
+
+private:
+    FILE *_file;
+    bool _owned;    // opened by begin(path), closed by end()
+};
+
+#endif
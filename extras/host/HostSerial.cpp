@@ -0,0 +1,189 @@
+#include "HostSerial.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+
+static speed_t _baudToSpeed(unsigned long baud)
+{
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+    }
+}
+
+HostSerial::HostSerial()
+{
+    _fd = -1;
+    _rx_pos = 0;
+    _rx_len = 0;
+    _tx_len = 0;
+}
+
+HostSerial::~HostSerial()
+{
+    end();
+}
+
+bool HostSerial::begin(const char *path, unsigned long baud)
+{
+    struct termios tio;
+    speed_t speed = _baudToSpeed(baud);
+
+    end();
+    if (speed == B0) {
+        return false;
+    }
+
+    _fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (_fd < 0) {
+        return false;
+    }
+
+    if (tcgetattr(_fd, &tio) != 0) {
+        end();
+        return false;
+    }
+    // raw 8N1, no flow control, reads return immediately
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(_fd, TCSANOW, &tio) != 0) {
+        end();
+        return false;
+    }
+    tcflush(_fd, TCIOFLUSH);
+
+    _rx_pos = 0;
+    _rx_len = 0;
+    _tx_len = 0;
+    return true;
+}
+
+void HostSerial::end()
+{
+    if (_fd >= 0) {
+        flush();
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+int HostSerial::fd()
+{
+    return _fd;
+}
+
+// reads what the tty has into rx buffer without blocking, returns true if buffer has data
+bool HostSerial::_fill()
+{
+    if (_rx_pos < _rx_len) {
+        return true;
+    }
+    _rx_pos = 0;
+    _rx_len = 0;
+    if (_fd < 0) {
+        return false;
+    }
+
+    ssize_t n = ::read(_fd, _rx_buf, sizeof(_rx_buf));
+    if (n > 0) {
+        _rx_len = n;
+        return true;
+    }
+    return false;
+}
+
+int HostSerial::available()
+{
+    _fill();
+    return _rx_len - _rx_pos;
+}
+
+int HostSerial::read()
+{
+    if (!_fill()) {
+        return -1;
+    }
+    return _rx_buf[_rx_pos++];
+}
+
+int HostSerial::peek()
+{
+    if (!_fill()) {
+        return -1;
+    }
+    return _rx_buf[_rx_pos];
+}
+
+size_t HostSerial::write(uint8_t ch)
+{
+    if (_tx_len >= sizeof(_tx_buf)) {
+        flush();
+    }
+    _tx_buf[_tx_len++] = ch;
+    return 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; i++) {
+        write(buffer[i]);
+    }
+    return size;
+}
+
+void HostSerial::flush()
+{
+    uint16_t pos = 0;
+
+    while (_fd >= 0 && pos < _tx_len) {
+        ssize_t n = ::write(_fd, _tx_buf + pos, _tx_len - pos);
+        if (n > 0) {
+            pos += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            // tty output queue is full
+            struct pollfd pfd = { _fd, POLLOUT, 0 };
+            poll(&pfd, 1, 100);
+        } else {
+            // tty is gone, drop output
+            break;
+        }
+    }
+    _tx_len = 0;
+}
+
+bool HostSerial::wait(uint32_t timeout_ms)
+{
+    if (_rx_pos < _rx_len) {
+        return true;
+    }
+    if (_fd < 0) {
+        return false;
+    }
+
+    struct pollfd pfd = { _fd, POLLIN, 0 };
+    int ret = poll(&pfd, 1, timeout_ms > 0x7fffffff ? -1 : (int) timeout_ms);
+    if (ret > 0 && !(pfd.revents & POLLIN)) {
+        // hangup or error, e.g. USB adapter unplugged, sleep instead of returning at once
+        delay(timeout_ms);
+        return false;
+    }
+    return ret > 0;
+}
+
+void HostSerial::waitHook(void *context, uint32_t timeout_ms)
+{
+    ((HostSerial*) context)->wait(timeout_ms);
+}
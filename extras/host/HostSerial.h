@@ -0,0 +1,45 @@
+
+#ifndef _HOST_SERIAL_H
+#define _HOST_SERIAL_H
+
+#include "Arduino.h"
+#include "Stream.h"
+
+#define HOST_SERIAL_RX_BUFFER 256
+#define HOST_SERIAL_TX_BUFFER 256
+
+// Stream over a Linux tty, e.g. /dev/ttyUSB0, for running the library on a gateway
+// reads don't block, wait() sleeps in poll() until data arrives
+class HostSerial : public Stream
+{
+public:
+    HostSerial();
+    ~HostSerial();
+
+    bool begin(const char *path, unsigned long baud = 115200);  // opens tty as 8N1 raw, returns false on error
+    void end();
+    int fd();                           // file descriptor, -1 if closed
+
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual size_t write(uint8_t ch);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual void flush();               // writes buffered output to tty
+
+    bool wait(uint32_t timeout_ms);     // returns true when data is available, false after timeout
+    // for SwarmTile::setWaitHook, context is the HostSerial
+    static void waitHook(void *context, uint32_t timeout_ms);
+
+private:
+    int _fd;
+    uint8_t _rx_buf[HOST_SERIAL_RX_BUFFER];
+    uint16_t _rx_pos;       // next byte to read
+    uint16_t _rx_len;       // bytes in buffer
+    uint8_t _tx_buf[HOST_SERIAL_TX_BUFFER];
+    uint16_t _tx_len;
+
+    bool _fill();
+};
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <inttypes.h>
 #include <stdio.h> // for size_t
+#include <string.h> // for strlen
 
 // #include "WString.h"
 // #include "Printable.h"
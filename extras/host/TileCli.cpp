@@ -0,0 +1,453 @@
+#include "TileCli.h"
+#include "TileQueue.h"
+#include <getopt.h>
+#include <stdlib.h>
+
+static const char *_status_names[] = {
+    "TILE_SUCCESS", "TILE_TIMEOUT", "TILE_PROTOCOL_ERROR",
+    "TILE_COMMAND_ERROR", "TILE_RX_OVERFLOW", "TILE_NO_GPS_FIX"
+};
+
+static const char *_statusName(tile_status_t result)
+{
+    if ((unsigned) result < sizeof(_status_names) / sizeof(_status_names[0])) {
+        return _status_names[result];
+    }
+    return "TILE_UNKNOWN";
+}
+
+static void _jsonString(FILE *out, const char *str, size_t len)
+{
+    size_t i;
+
+    fputc('"', out);
+    for (i = 0; i < len; i++) {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+TileCli::TileCli(SwarmTile &tile, FILE *in, FILE *out) : _tile(tile)
+{
+    _in = in;
+    _out = out;
+    _json = false;
+    _wait_hook = 0;
+    _wait_context = 0;
+    _tail_lines = 0;
+    _stop = 0;
+}
+
+void TileCli::setJson(bool json)
+{
+    _json = json;
+}
+
+void TileCli::setWaitHook(tile_wait_hook_t hook, void *context)
+{
+    _wait_hook = hook;
+    _wait_context = context;
+}
+
+void TileCli::stop()
+{
+    _stop = 1;
+}
+
+int TileCli::run(int argc, char *argv[])
+{
+    int ret = 2;
+
+    if (argc < 1) {
+        fprintf(stderr, "missing command: send, drain, delete, status, tail\n");
+        return ret;
+    }
+
+    // glibc restarts option parsing at argv[1] when optind is 0
+    optind = 0;
+
+    if (strcmp(argv[0], "send") == 0) {
+        ret = _send(argc, argv);
+    } else if (strcmp(argv[0], "drain") == 0) {
+        ret = _drain(argc, argv);
+    } else if (strcmp(argv[0], "delete") == 0) {
+        ret = _delete(argc, argv);
+    } else if (strcmp(argv[0], "status") == 0) {
+        ret = _status(argc, argv);
+    } else if (strcmp(argv[0], "tail") == 0) {
+        ret = _tail(argc, argv);
+    } else {
+        fprintf(stderr, "unknown command: %s\n", argv[0]);
+    }
+
+    fflush(_out);
+    return ret;
+}
+
+// sends one message per input line, reports result per line
+int TileCli::_send(int argc, char *argv[])
+{
+    tile_send_msg_t msg;
+    FILE *in = _in;
+    const char *file = 0;
+    uint16_t app_id = 0;
+    uint32_t hold_time = 0;
+    uint8_t priority = TILE_PRIORITY_NORMAL;
+    uint8_t window = 0;
+    uint32_t limit_s = 0;
+    unsigned long start = millis();
+    uint32_t line_no = 0;
+    uint32_t failed = 0;
+    char line[TILE_MAX_MSG_SIZE * 4];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:a:H:p:w:T:")) != -1) {
+        switch (opt) {
+        case 'f': file = optarg; break;
+        case 'a': app_id = strtoul(optarg, 0, 0); break;
+        case 'H': hold_time = strtoul(optarg, 0, 0); break;
+        case 'p': priority = strtoul(optarg, 0, 0); break;
+        case 'w': window = strtoul(optarg, 0, 0); break;
+        case 'T': limit_s = strtoul(optarg, 0, 0); break;
+        default: return 2;
+        }
+    }
+
+    if (file && (in = fopen(file, "r")) == 0) {
+        perror(file);
+        return 1;
+    }
+
+    // with a window, messages wait in a local queue until Tile confirms sent messages
+    uint8_t *queue_buf = window > 0 ? (uint8_t*) malloc(TILE_CLI_QUEUE_SIZE) : 0;
+    TileRamStorage storage(queue_buf, queue_buf ? TILE_CLI_QUEUE_SIZE : 0);
+    TileQueue queue(storage, TILE_DROP_NEWEST);
+    if (queue_buf) {
+        _tile.setOverflowQueue(&queue);
+        _tile.setSendWindow(window);
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        // rest of a line longer than the buffer would go out as a message of its own
+        bool too_long = strchr(line, '\n') == 0 && !feof(in);
+        if (too_long) {
+            int ch;
+            while ((ch = fgetc(in)) != EOF && ch != '\n');
+        }
+        size_t len = strcspn(line, "\r\n");
+        line[len] = 0;
+        line_no++;
+        if (len == 0 && !too_long) {
+            continue;
+        }
+        too_long = too_long || len > TILE_MAX_MSG_SIZE;
+
+        tile_status_t result;
+        memset(&msg, 0, sizeof(msg));
+        msg.message = line;
+        msg.msg_len = len;
+        msg.app_id = app_id;
+        msg.hold_time = hold_time;
+        msg.priority = priority;
+        if (too_long) {
+            result = TILE_COMMAND_ERROR;
+        } else {
+            while (1) {
+                result = _tile.sendMessage(msg);
+                if (queue_buf == 0 || result != TILE_COMMAND_ERROR || _tile.getError() != TILE_ERR_QUEUEFULL ||
+                    (limit_s > 0 && millis() - start >= limit_s * 1000UL) || _stop) {
+                    break;
+                }
+                // local queue is full, wait for Tile to send messages
+                _tile.poll();
+                _wait(1000);
+            }
+        }
+
+        if (result != TILE_SUCCESS) {
+            failed++;
+        }
+        const char *err = too_long ? "BADDATA" : _tile.getErrorStr();
+        if (_json) {
+            fprintf(_out, "{\"line\":%u,\"status\":\"%s\"", line_no, _statusName(result));
+            if (result == TILE_SUCCESS) {
+                fprintf(_out, ",\"msg_id\":%llu,\"held\":%s}\n", (unsigned long long) msg.msg_id,
+                    msg.queued ? "true" : "false");
+            } else {
+                fprintf(_out, ",\"error\":");
+                _jsonString(_out, err, strlen(err));
+                fprintf(_out, "}\n");
+            }
+        } else if (result == TILE_SUCCESS && msg.queued) {
+            fprintf(_out, "%u held\n", line_no);
+        } else if (result == TILE_SUCCESS) {
+            fprintf(_out, "%u queued %llu\n", line_no, (unsigned long long) msg.msg_id);
+        } else {
+            fprintf(_out, "%u %s %s\n", line_no, _statusName(result), err);
+        }
+        fflush(_out);
+    }
+
+    if (queue_buf) {
+        // hand remaining messages to Tile before exiting, can take until the next satellite passes
+        uint16_t waiting = 0;
+        while (queue.count() > 0) {
+            if (queue.count() != waiting) {
+                waiting = queue.count();
+                fprintf(stderr, "%u messages waiting for Tile\n", waiting);
+            }
+            if ((limit_s > 0 && millis() - start >= limit_s * 1000UL) || _stop) {
+                fprintf(stderr, "%s, %u messages not handed to Tile\n",
+                    _stop ? "interrupted" : "time limit reached", waiting);
+                failed += waiting;
+                break;
+            }
+            _tile.poll();
+            _wait(1000);
+        }
+        _tile.setOverflowQueue(0);
+        _tile.setSendWindow(0);
+        free(queue_buf);
+    }
+    if (file) {
+        fclose(in);
+    }
+
+    return failed ? 1 : 0;
+}
+
+// reads all unread messages into files named by msg_id
+int TileCli::_drain(int argc, char *argv[])
+{
+    tile_msg_count_t count;
+    tile_read_msg_t msg;
+    tile_status_t result;
+    char buf[TILE_MAX_MSG_SIZE];
+    char path[512];
+    uint16_t i;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: drain <dir>\n");
+        return 2;
+    }
+
+    result = _tile.getUnreadCount(count);
+    if (result != TILE_SUCCESS) {
+        return _error("unread count", result);
+    }
+
+    // read as many as Tile reported, new arrivals are left for next drain
+    for (i = 0; i < count.count; i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.message = buf;
+        msg.msg_max = sizeof(buf);
+        msg.order = TILE_OLDEST;
+        result = _tile.readMessage(msg);
+        if (result == TILE_COMMAND_ERROR && _tile.getError() == TILE_ERR_DBXNOMORE) {
+            break;
+        }
+        if (result != TILE_SUCCESS) {
+            return _error("read", result);
+        }
+
+        snprintf(path, sizeof(path), "%s/%llu.bin", argv[1], (unsigned long long) msg.msg_id);
+        FILE *f = fopen(path, "wb");
+        if (f == 0 || fwrite(buf, 1, msg.msg_len, f) != msg.msg_len) {
+            perror(path);
+            if (f) {
+                fclose(f);
+            }
+            return 1;
+        }
+        fclose(f);
+
+        if (_json) {
+            fprintf(_out, "{\"msg_id\":%llu,\"app_id\":%u,\"timestamp\":%u,\"length\":%u,\"file\":",
+                (unsigned long long) msg.msg_id, msg.app_id, SwarmTile::makeEpoch(msg.timestamp), msg.msg_len);
+            _jsonString(_out, path, strlen(path));
+            fprintf(_out, "}\n");
+        } else {
+            fprintf(_out, "%llu %u %u %u %s\n", (unsigned long long) msg.msg_id, msg.app_id,
+                SwarmTile::makeEpoch(msg.timestamp), msg.msg_len, path);
+        }
+    }
+
+    return 0;
+}
+
+int TileCli::_delete(int argc, char *argv[])
+{
+    tile_msg_count_t count;
+    tile_status_t result;
+
+    if (argc == 2 && strcmp(argv[1], "read") == 0) {
+        result = _tile.deleteReadMsgs(count);
+    } else if (argc == 2 && strcmp(argv[1], "unsent") == 0) {
+        result = _tile.deleteUnsentMsgs(count);
+    } else {
+        fprintf(stderr, "usage: delete read|unsent\n");
+        return 2;
+    }
+    if (result != TILE_SUCCESS) {
+        return _error("delete", result);
+    }
+
+    if (_json) {
+        fprintf(_out, "{\"deleted\":%u}\n", count.count);
+    } else {
+        fprintf(_out, "deleted %u\n", count.count);
+    }
+    return 0;
+}
+
+int TileCli::_status(int argc, char *argv[])
+{
+    tile_status_snapshot_t snapshot;
+    tile_status_t result;
+
+    // one pipelined exchange, members the Tile didn't answer are reported as null
+    result = _tile.getStatusSnapshot(snapshot);
+
+    if (_json) {
+        fprintf(_out, "{\"status\":\"%s\"", _statusName(result));
+        if (snapshot.datetime.valid) {
+            fprintf(_out, ",\"datetime\":%u", SwarmTile::makeEpoch(snapshot.datetime));
+        } else {
+            fprintf(_out, ",\"datetime\":null");
+        }
+        if (snapshot.unsent.valid) {
+            fprintf(_out, ",\"unsent\":%u", snapshot.unsent.count);
+        } else {
+            fprintf(_out, ",\"unsent\":null");
+        }
+        if (snapshot.unread.valid) {
+            fprintf(_out, ",\"unread\":%u", snapshot.unread.count);
+        } else {
+            fprintf(_out, ",\"unread\":null");
+        }
+        fprintf(_out, ",\"gps_fix\":%s", snapshot.gps_fix ? "true" : "false");
+        if (snapshot.geo_data.valid) {
+            fprintf(_out, ",\"latitude\":%.6f,\"longitude\":%.6f,\"altitude\":%.1f",
+                snapshot.geo_data.latitude, snapshot.geo_data.longitude, snapshot.geo_data.altitude);
+        }
+        if (snapshot.version.valid) {
+            fprintf(_out, ",\"version\":");
+            _jsonString(_out, snapshot.version.version_str, strlen(snapshot.version.version_str));
+        }
+        fprintf(_out, "}\n");
+    } else {
+        fprintf(_out, "status %s\n", _statusName(result));
+        if (snapshot.datetime.valid) {
+            fprintf(_out, "datetime %04u-%02u-%02u %02u:%02u:%02u\n", snapshot.datetime.year,
+                snapshot.datetime.month, snapshot.datetime.day, snapshot.datetime.hour,
+                snapshot.datetime.minute, snapshot.datetime.second);
+        }
+        if (snapshot.unsent.valid) {
+            fprintf(_out, "unsent %u\n", snapshot.unsent.count);
+        }
+        if (snapshot.unread.valid) {
+            fprintf(_out, "unread %u\n", snapshot.unread.count);
+        }
+        fprintf(_out, "gps_fix %u\n", snapshot.gps_fix);
+        if (snapshot.geo_data.valid) {
+            fprintf(_out, "position %.6f %.6f %.1f\n", snapshot.geo_data.latitude,
+                snapshot.geo_data.longitude, snapshot.geo_data.altitude);
+        }
+        if (snapshot.version.valid) {
+            fprintf(_out, "version %s\n", snapshot.version.version_str);
+        }
+    }
+
+    return result == TILE_SUCCESS ? 0 : 1;
+}
+
+// prints unsolicited messages until line count or time is reached, 0 for no limit
+int TileCli::_tail(int argc, char *argv[])
+{
+    uint32_t max_lines = 0;
+    uint32_t seconds = 0;
+    unsigned long start = millis();
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n': max_lines = strtoul(optarg, 0, 0); break;
+        case 't': seconds = strtoul(optarg, 0, 0); break;
+        default: return 2;
+        }
+    }
+
+    _tail_lines = 0;
+    _tile.setUnsolicitedHook(_printUnsolicited, this);
+    while (!_stop && (max_lines == 0 || _tail_lines < max_lines)) {
+        uint32_t wait_ms = 1000;
+        if (seconds > 0) {
+            unsigned long elapsed = millis() - start;
+            if (elapsed >= seconds * 1000UL) {
+                break;
+            }
+            if (seconds * 1000UL - elapsed < wait_ms) {
+                wait_ms = seconds * 1000UL - elapsed;
+            }
+        }
+        _tile.poll();
+        _wait(wait_ms);
+    }
+    _tile.poll();
+    _tile.setUnsolicitedHook(0);
+
+    return 0;
+}
+
+void TileCli::_printUnsolicited(void *context, const tile_response_t &response)
+{
+    TileCli *cli = (TileCli*) context;
+    const tile_field_t &last = response.fields[response.field_count];
+    const char *line = response.fields[0].ptr;
+    size_t len = last.ptr + last.len - line;
+    uint8_t i;
+
+    if (cli->_json) {
+        fprintf(cli->_out, "{\"sentence\":");
+        _jsonString(cli->_out, line, len);
+        fprintf(cli->_out, ",\"fields\":[");
+        for (i = 0; i <= response.field_count; i++) {
+            fprintf(cli->_out, i ? "," : "");
+            _jsonString(cli->_out, response.fields[i].ptr, response.fields[i].len);
+        }
+        fprintf(cli->_out, "]}\n");
+    } else {
+        fprintf(cli->_out, "%.*s\n", (int) len, line);
+    }
+    fflush(cli->_out);
+    cli->_tail_lines++;
+}
+
+// sleep until Tile sends data or timeout, without a hook in short steps
+void TileCli::_wait(uint32_t timeout_ms)
+{
+    if (_wait_hook) {
+        _wait_hook(_wait_context, timeout_ms);
+    } else {
+        delay(timeout_ms < 10 ? timeout_ms : 10);
+    }
+}
+
+int TileCli::_error(const char *what, tile_status_t result)
+{
+    if (_json) {
+        fprintf(_out, "{\"status\":\"%s\",\"error\":", _statusName(result));
+        _jsonString(_out, _tile.getErrorStr(), strlen(_tile.getErrorStr()));
+        fprintf(_out, "}\n");
+    } else {
+        fprintf(_out, "%s: %s %s\n", what, _statusName(result), _tile.getErrorStr());
+    }
+    return 1;
+}
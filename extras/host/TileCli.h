@@ -0,0 +1,55 @@
+
+#ifndef _TILE_CLI_H
+#define _TILE_CLI_H
+
+#include <signal.h>
+#include <stdio.h>
+#include "SwarmTile.h"
+
+// size of local queue used by "send -w"
+#define TILE_CLI_QUEUE_SIZE 65536
+
+// subcommands of the tilectl tool, separate from main() to run against any Stream
+//
+//   send [-f file] [-a app_id] [-H hold_time] [-p priority] [-w window] [-T seconds]
+//                      one message per input line, longer lines fail with BADDATA and aren't sent,
+//                      -w keeps at most window messages on Tile,
+//                      -T stops waiting for the Tile to take queued messages after seconds
+//   drain <dir>        reads unread messages into <dir>/<msg_id>.bin
+//   delete read|unsent
+//   status             status snapshot
+//   tail [-n lines] [-t seconds]
+//                      prints unsolicited messages
+class TileCli
+{
+public:
+    TileCli(SwarmTile &tile, FILE *in, FILE *out);
+
+    void setJson(bool json);        // JSON lines instead of text output
+    void setWaitHook(tile_wait_hook_t hook, void *context = 0);    // used by send -w and tail
+    void stop();                    // ends waits of send -w and tail, safe in a signal handler
+
+    int run(int argc, char *argv[]);    // argv[0] is the subcommand, returns exit code
+
+private:
+    SwarmTile &_tile;
+    FILE *_in;
+    FILE *_out;
+    bool _json;
+    tile_wait_hook_t _wait_hook;
+    void *_wait_context;
+    uint32_t _tail_lines;       // unsolicited messages printed by tail
+    volatile sig_atomic_t _stop;
+
+    int _send(int argc, char *argv[]);
+    int _drain(int argc, char *argv[]);
+    int _delete(int argc, char *argv[]);
+    int _status(int argc, char *argv[]);
+    int _tail(int argc, char *argv[]);
+
+    void _wait(uint32_t timeout_ms);
+    int _error(const char *what, tile_status_t result);
+    static void _printUnsolicited(void *context, const tile_response_t &response);
+};
+
+#endif
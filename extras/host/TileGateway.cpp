@@ -0,0 +1,365 @@
+#include "TileGateway.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// how often to check the stream for unsolicited messages without a descriptor to wait on
+#define TILE_GW_STREAM_POLL_MS 50
+
+static void _put16(uint8_t *buf, uint16_t v)
+{
+    buf[0] = v;
+    buf[1] = v >> 8;
+}
+
+static void _put32(uint8_t *buf, uint32_t v)
+{
+    _put16(buf, v);
+    _put16(buf + 2, v >> 16);
+}
+
+static void _put64(uint8_t *buf, uint64_t v)
+{
+    _put32(buf, v);
+    _put32(buf + 4, v >> 32);
+}
+
+static uint16_t _get16(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t _get32(const uint8_t *buf)
+{
+    return _get16(buf) | ((uint32_t) _get16(buf + 2) << 16);
+}
+
+TileGateway::TileGateway(SwarmTile &tile, int tile_fd) : _tile(tile)
+{
+    uint8_t i;
+
+    _tile_fd = tile_fd;
+    _listen_fd = -1;
+    _path[0] = 0;
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        _clients[i].fd = -1;
+    }
+    _sent_seen = 0;
+    _unread = 0;
+    _inbox_interval_ms = TILE_GW_INBOX_INTERVAL_MS;
+    _inbox_ms = 0;
+}
+
+TileGateway::~TileGateway()
+{
+    end();
+}
+
+bool TileGateway::begin(const char *path)
+{
+    struct sockaddr_un addr;
+    tile_link_stats_t stats;
+
+    end();
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen_fd < 0) {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // remove socket left behind by a previous run
+    unlink(path);
+    if (bind(_listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+        listen(_listen_fd, TILE_GW_MAX_CLIENTS) != 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        return false;
+    }
+    strcpy(_path, path);
+
+    // only forward confirmations from now on, each as the library processes it
+    _tile.getLinkStats(stats);
+    _sent_seen = stats.sent;
+    _tile.setUnsolicitedHook(_unsolicited, this);
+    _inbox_ms = millis();
+    return true;
+}
+
+void TileGateway::end()
+{
+    uint8_t i;
+
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        _drop(_clients[i]);
+    }
+    if (_listen_fd >= 0) {
+        _tile.setUnsolicitedHook(0);
+        close(_listen_fd);
+        unlink(_path);
+        _listen_fd = -1;
+    }
+}
+
+void TileGateway::setInboxInterval(uint32_t interval_ms)
+{
+    _inbox_interval_ms = interval_ms;
+    _inbox_ms = millis();
+}
+
+void TileGateway::process(int timeout_ms)
+{
+    struct pollfd fds[2 + TILE_GW_MAX_CLIENTS];
+    uint8_t client_idx[TILE_GW_MAX_CLIENTS];
+    uint8_t n = 0;
+    uint8_t clients;
+    uint8_t i;
+
+    if (_tile_fd < 0 && (timeout_ms < 0 || timeout_ms > TILE_GW_STREAM_POLL_MS)) {
+        timeout_ms = TILE_GW_STREAM_POLL_MS;
+    }
+    if (_inbox_interval_ms > 0) {
+        uint32_t elapsed = millis() - _inbox_ms;
+        int remaining = elapsed < _inbox_interval_ms ? _inbox_interval_ms - elapsed : 0;
+        if (timeout_ms < 0 || remaining < timeout_ms) {
+            timeout_ms = remaining;
+        }
+    }
+
+    fds[n].fd = _listen_fd;
+    fds[n++].events = POLLIN;
+    fds[n].fd = _tile_fd;
+    fds[n++].events = POLLIN;
+    clients = 0;
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        if (_clients[i].fd >= 0) {
+            client_idx[clients++] = i;
+            fds[n].fd = _clients[i].fd;
+            fds[n++].events = POLLIN;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        fds[i].revents = 0;
+    }
+
+    if (poll(fds, n, timeout_ms) < 0 && errno != EINTR) {
+        return;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        _accept();
+    }
+
+    // pick up unsolicited messages, e.g. $TD SENT
+    _tile.poll();
+
+    for (i = 0; i < clients; i++) {
+        if (fds[2 + i].revents) {
+            _receive(_clients[client_idx[i]]);
+        }
+    }
+
+    _checkInbox();
+}
+
+void TileGateway::_accept()
+{
+    uint8_t i;
+    int fd = accept4(_listen_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return;
+    }
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        if (_clients[i].fd < 0) {
+            _clients[i].fd = fd;
+            _clients[i].events = 0;
+            _clients[i].rx_len = 0;
+            return;
+        }
+    }
+    // no free slot
+    close(fd);
+}
+
+// read from client and handle complete frames
+void TileGateway::_receive(_client_t &client)
+{
+    ssize_t n = recv(client.fd, client.rx + client.rx_len, sizeof(client.rx) - client.rx_len, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        // client went away
+        _drop(client);
+        return;
+    }
+    if (n < 0) {
+        return;
+    }
+    client.rx_len += n;
+
+    while (client.fd >= 0 && client.rx_len >= TILE_GW_HEADER_SIZE) {
+        uint16_t len = _get16(client.rx + 1);
+        if (len > TILE_GW_MAX_PAYLOAD) {
+            // not speaking our protocol
+            _drop(client);
+            return;
+        }
+        if (client.rx_len < TILE_GW_HEADER_SIZE + len) {
+            // wait for rest of frame
+            return;
+        }
+        _handle(client, client.rx[0], client.rx + TILE_GW_HEADER_SIZE, len);
+        if (client.fd < 0) {
+            return;
+        }
+        client.rx_len -= TILE_GW_HEADER_SIZE + len;
+        memmove(client.rx, client.rx + TILE_GW_HEADER_SIZE + len, client.rx_len);
+    }
+}
+
+// run request against Tile, commands of all clients are serialized through this loop
+void TileGateway::_handle(_client_t &client, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint8_t out[TILE_GW_MAX_PAYLOAD];
+    uint16_t out_len = 2;
+    tile_status_t result = TILE_PROTOCOL_ERROR;   // malformed or unknown request
+
+    if (type == TILE_GW_SEND && len >= 7) {
+        tile_send_msg_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.app_id = _get16(payload);
+        msg.hold_time = _get32(payload + 2);
+        msg.priority = payload[6];
+        msg.message = (const char*) payload + 7;
+        msg.msg_len = len - 7;
+        result = _tile.sendMessage(msg);
+        _put64(out + out_len, msg.msg_id);
+        out[out_len + 8] = msg.queued;
+        out_len += 9;
+    } else if (type == TILE_GW_READ) {
+        tile_read_msg_t msg;
+        char buf[TILE_MAX_MSG_SIZE];
+        memset(&msg, 0, sizeof(msg));
+        msg.message = buf;
+        msg.msg_max = sizeof(buf);
+        msg.order = TILE_OLDEST;
+        result = _tile.readMessage(msg);
+        if (result == TILE_SUCCESS) {
+            _put16(out + out_len, msg.app_id);
+            _put64(out + out_len + 2, msg.msg_id);
+            _put32(out + out_len + 10, SwarmTile::makeEpoch(msg.timestamp));
+            memcpy(out + out_len + 14, buf, msg.msg_len);
+            out_len += 14 + msg.msg_len;
+        }
+    } else if (type == TILE_GW_STATUS) {
+        tile_status_snapshot_t snapshot;
+        result = _tile.getStatusSnapshot(snapshot);
+        _put16(out + out_len, snapshot.unsent.valid ? snapshot.unsent.count : 0);
+        _put16(out + out_len + 2, snapshot.unread.valid ? snapshot.unread.count : 0);
+        _put32(out + out_len + 4, SwarmTile::makeEpoch(snapshot.datetime));
+        out[out_len + 8] = snapshot.gps_fix;
+        memcpy(out + out_len + 9, &snapshot.geo_data.latitude, 4);
+        memcpy(out + out_len + 13, &snapshot.geo_data.longitude, 4);
+        out_len += 17;
+    } else if (type == TILE_GW_SUBSCRIBE && len == 1) {
+        client.events = payload[0];
+        result = TILE_SUCCESS;
+    }
+
+    out[0] = result;
+    out[1] = result == TILE_COMMAND_ERROR ? _tile.getError() : TILE_ERR_NONE;
+    _send(client, type | TILE_GW_RESPONSE, out, out_len);
+}
+
+void TileGateway::_send(_client_t &client, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint8_t frame[TILE_GW_HEADER_SIZE + TILE_GW_MAX_PAYLOAD];
+
+    frame[0] = type;
+    _put16(frame + 1, len);
+    memcpy(frame + TILE_GW_HEADER_SIZE, payload, len);
+    if (send(client.fd, frame, TILE_GW_HEADER_SIZE + len, MSG_NOSIGNAL) != TILE_GW_HEADER_SIZE + len) {
+        // client doesn't keep up, frames are never split
+        _drop(client);
+    }
+}
+
+void TileGateway::_broadcast(uint8_t event, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    uint8_t i;
+
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        if (_clients[i].fd >= 0 && (_clients[i].events & event)) {
+            _send(_clients[i], type, payload, len);
+        }
+    }
+}
+
+void TileGateway::_drop(_client_t &client)
+{
+    if (client.fd >= 0) {
+        close(client.fd);
+        client.fd = -1;
+    }
+}
+
+// forwards $TD SENT confirmations, called for every unsolicited message the library processed,
+// also while it waits for a response, so no confirmation is missed between calls of process()
+void TileGateway::_unsolicited(void *context, const tile_response_t &response)
+{
+    TileGateway *gw = (TileGateway*) context;
+    tile_link_stats_t stats;
+    tile_sent_record_t record;
+    uint8_t out[14];
+
+    gw->_tile.getLinkStats(stats);
+    if (stats.sent == gw->_sent_seen) {
+        // not a confirmation or one the library couldn't parse
+        return;
+    }
+    gw->_sent_seen = stats.sent;
+    if (gw->_tile.getSentLog(&record, 1) != 1) {
+        return;
+    }
+
+    _put64(out, record.msg_id);
+    _put16(out + 8, record.rssi);
+    _put16(out + 10, record.snr);
+    _put16(out + 12, record.fdev);
+    gw->_broadcast(TILE_GW_SUB_SENT, TILE_GW_EVENT_SENT, out, sizeof(out));
+}
+
+// ask Tile for unread messages and notify subscribers when more arrived
+void TileGateway::_checkInbox()
+{
+    tile_msg_count_t count;
+    uint8_t out[2];
+    uint8_t i;
+    bool subscribed = false;
+
+    if (_inbox_interval_ms == 0 || millis() - _inbox_ms < _inbox_interval_ms) {
+        return;
+    }
+    _inbox_ms = millis();
+
+    for (i = 0; i < TILE_GW_MAX_CLIENTS; i++) {
+        if (_clients[i].fd >= 0 && (_clients[i].events & TILE_GW_SUB_INBOX)) {
+            subscribed = true;
+        }
+    }
+    if (!subscribed || _tile.getUnreadCount(count) != TILE_SUCCESS || !count.valid) {
+        return;
+    }
+
+    if (count.count > _unread) {
+        _put16(out, count.count);
+        _broadcast(TILE_GW_SUB_INBOX, TILE_GW_EVENT_INBOX, out, sizeof(out));
+    }
+    _unread = count.count;
+}
@@ -0,0 +1,95 @@
+
+#ifndef _TILE_GATEWAY_H
+#define _TILE_GATEWAY_H
+
+#include "SwarmTile.h"
+
+// Shares one Tile among local clients over a UNIX domain socket.
+//
+// Frames in both directions: type (1 byte), payload length (2 bytes), payload.
+// Integers are little endian. Every request is answered by a frame of type
+// request | TILE_GW_RESPONSE whose payload starts with tile_status_t (1 byte)
+// and tile_error_t (1 byte). Events are only sent to clients that subscribed.
+//
+// TILE_GW_SEND       app_id (2), hold_time (4), priority (1), message
+//      response      msg_id (8), queued (1)
+// TILE_GW_READ       -
+//      response      app_id (2), msg_id (8), timestamp (4, UTC epoch), message
+// TILE_GW_STATUS     -
+//      response      unsent (2), unread (2), datetime (4, UTC epoch, 0 if unknown),
+//                    gps_fix (1), latitude (4, float), longitude (4, float)
+// TILE_GW_SUBSCRIBE  events (1, tile_gw_event_t bits)
+//      response      -
+// TILE_GW_EVENT_SENT       msg_id (8), rssi (2), snr (2), fdev (2)
+// TILE_GW_EVENT_INBOX      unread (2)
+
+#define TILE_GW_HEADER_SIZE 3
+#define TILE_GW_MAX_PAYLOAD (TILE_MAX_MSG_SIZE + 16)
+
+#ifndef TILE_GW_MAX_CLIENTS
+#define TILE_GW_MAX_CLIENTS 8
+#endif
+
+// time between asking Tile for unread messages
+#define TILE_GW_INBOX_INTERVAL_MS 10000
+
+typedef enum {
+    TILE_GW_SEND = 0x01,
+    TILE_GW_READ = 0x02,
+    TILE_GW_STATUS = 0x03,
+    TILE_GW_SUBSCRIBE = 0x04,
+    TILE_GW_EVENT_SENT = 0x41,
+    TILE_GW_EVENT_INBOX = 0x42,
+    TILE_GW_RESPONSE = 0x80
+} tile_gw_frame_t;
+
+typedef enum {
+    TILE_GW_SUB_SENT = 0x01,    // $TD SENT confirmations
+    TILE_GW_SUB_INBOX = 0x02    // new unread messages
+} tile_gw_event_t;
+
+class TileGateway
+{
+public:
+    // tile_fd is the descriptor of the Tile's serial port, -1 to check the stream periodically
+    TileGateway(SwarmTile &tile, int tile_fd = -1);
+    ~TileGateway();
+
+    // listens on socket path, returns false on error, uses the Tile's unsolicited hook until end()
+    bool begin(const char *path);
+    void end();
+
+    // serves clients and forwards events, blocks for up to timeout_ms, -1 to wait for activity
+    void process(int timeout_ms);
+    void setInboxInterval(uint32_t interval_ms);    // 0 to disable inbox events
+
+private:
+    SwarmTile &_tile;
+    int _tile_fd;
+    int _listen_fd;
+    char _path[108];
+
+    typedef struct {
+        int fd;             // -1 if slot is free
+        uint8_t events;     // tile_gw_event_t bits
+        uint8_t rx[TILE_GW_HEADER_SIZE + TILE_GW_MAX_PAYLOAD];
+        uint16_t rx_len;
+    } _client_t;
+    _client_t _clients[TILE_GW_MAX_CLIENTS];
+
+    uint32_t _sent_seen;        // $TD SENT confirmations already forwarded
+    uint16_t _unread;           // unread count of last inbox event
+    uint32_t _inbox_interval_ms;
+    unsigned long _inbox_ms;    // millis() of last inbox check
+
+    void _accept();
+    void _receive(_client_t &client);
+    void _handle(_client_t &client, uint8_t type, const uint8_t *payload, uint16_t len);
+    void _send(_client_t &client, uint8_t type, const uint8_t *payload, uint16_t len);
+    void _broadcast(uint8_t event, uint8_t type, const uint8_t *payload, uint16_t len);
+    void _drop(_client_t &client);
+    static void _unsolicited(void *context, const tile_response_t &response);
+    void _checkInbox();
+};
+
+#endif
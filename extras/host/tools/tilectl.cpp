@@ -0,0 +1,74 @@
+/*
+ * tilectl
+ *
+ * Command line access to a Tile for provisioning and diagnostics,
+ * see TileCli.h for the subcommands.
+ *
+ * usage: tilectl [-d tty] [-b baud] [-j] [-t trace] <command> [options]
+ *
+ * -d defaults to $TILE_PORT or /dev/ttyUSB0, -j prints JSON lines,
+ * -t appends the serial traffic to a trace file for replay in extras/test.
+ */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "HostFile.h"
+#include "HostSerial.h"
+#include "TileCli.h"
+
+static TileCli *running_cli;
+
+// end waits so the trace file is closed, e.g. for tail without limit
+static void onSignal(int sig)
+{
+    running_cli->stop();
+}
+
+int main(int argc, char *argv[])
+{
+    HostSerial port;
+    HostFile trace;
+    SwarmTile tile(port);
+    TileCli cli(tile, stdin, stdout);
+    const char *tty = getenv("TILE_PORT") ? getenv("TILE_PORT") : "/dev/ttyUSB0";
+    unsigned long baud = 115200;
+    int opt;
+
+    // stop at the subcommand, its options are parsed by TileCli
+    while ((opt = getopt(argc, argv, "+d:b:jt:")) != -1) {
+        switch (opt) {
+        case 'd': tty = optarg; break;
+        case 'b': baud = strtoul(optarg, 0, 10); break;
+        case 'j': cli.setJson(true); break;
+        case 't':
+            if (!trace.begin(optarg, true)) {
+                perror(optarg);
+                return 1;
+            }
+            tile.setDebugStream(&trace, TILE_DEBUG_TRACE);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d tty] [-b baud] [-j] [-t trace] send|drain|delete|status|tail ...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!port.begin(tty, baud)) {
+        perror(tty);
+        return 1;
+    }
+    tile.setWaitHook(HostSerial::waitHook, &port);
+    cli.setWaitHook(HostSerial::waitHook, &port);
+    tile.begin();
+
+    running_cli = &cli;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    int ret = cli.run(argc - optind, argv + optind);
+
+    trace.end();
+    port.end();
+    return ret;
+}
@@ -0,0 +1,55 @@
+/*
+ * tiled
+ *
+ * Owns the Tile's serial port and shares the Tile with local processes through
+ * a UNIX domain socket, see TileGateway.h for the protocol.
+ *
+ * usage: tiled <tty> <socket> [baud]
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "HostSerial.h"
+#include "TileGateway.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int sig)
+{
+    running = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    HostSerial port;
+    SwarmTile tile(port);
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <tty> <socket> [baud]\n", argv[0]);
+        return 2;
+    }
+
+    if (!port.begin(argv[1], argc > 3 ? strtoul(argv[3], 0, 10) : 115200)) {
+        perror(argv[1]);
+        return 1;
+    }
+    tile.setWaitHook(HostSerial::waitHook, &port);
+    tile.begin();
+
+    TileGateway gateway(tile, port.fd());
+    if (!gateway.begin(argv[2])) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (running) {
+        gateway.process(-1);
+    }
+
+    gateway.end();
+    port.end();
+    return 0;
+}
@@ -1,16 +1,112 @@
 #include "Arduino.h"
-#include <sys/timeb.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool _virtual_clock = false;
+static unsigned long _virtual_us = 0;      // simulated time while virtual clock is enabled
+static unsigned long _offset_us = 0;       // keeps real time monotonic after virtual time ran ahead
+
+static unsigned long _real_micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1000000 * now.tv_sec + now.tv_nsec / 1000 + _offset_us;
+}
 
 unsigned long millis() {
-    struct timeb now;
-    ftime(&now);
-    return 1000 * now.time + now.millitm;
+    return micros() / 1000;
+}
+
+unsigned long micros() {
+    if (_virtual_clock) {
+        return __atomic_load_n(&_virtual_us, __ATOMIC_SEQ_CST);
+    }
+    return _real_micros();
+}
+
+void delay(unsigned long ms) {
+    if (_virtual_clock) {
+        emu_advanceClock(ms * 1000);
+    } else {
+        usleep(ms * 1000);
+    }
+}
+
+void emu_setVirtualClock(bool enable)
+{
+    if (enable && !_virtual_clock) {
+        _virtual_us = _real_micros();
+    } else if (!enable && _virtual_clock) {
+        unsigned long now = _real_micros();
+        if (_virtual_us > now) {
+            _offset_us += _virtual_us - now;
+        }
+    }
+    _virtual_clock = enable;
+}
+
+bool emu_isVirtualClock()
+{
+    return _virtual_clock;
+}
+
+void emu_advanceClock(unsigned long us)
+{
+    __atomic_add_fetch(&_virtual_us, us, __ATOMIC_SEQ_CST);
+}
+
+#define EMU_PIN_COUNT 32
+
+static int _pin_level[EMU_PIN_COUNT];
+static void (*_pin_isr[EMU_PIN_COUNT])(void);
+static int _pin_isr_mode[EMU_PIN_COUNT];
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    if (pin >= EMU_PIN_COUNT) {
+        return LOW;
+    }
+    return _pin_level[pin];
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode)
+{
+    if (interrupt < EMU_PIN_COUNT) {
+        _pin_isr[interrupt] = isr;
+        _pin_isr_mode[interrupt] = mode;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    if (interrupt < EMU_PIN_COUNT) {
+        _pin_isr[interrupt] = 0;
+    }
+}
+
+void emu_setPin(uint8_t pin, int level)
+{
+    if (pin >= EMU_PIN_COUNT) {
+        return;
+    }
+    int prev = _pin_level[pin];
+    _pin_level[pin] = level;
+    if (_pin_isr[pin] && prev != level) {
+        if (_pin_isr_mode[pin] == CHANGE ||
+            (_pin_isr_mode[pin] == RISING && level == HIGH) ||
+            (_pin_isr_mode[pin] == FALLING && level == LOW)) {
+            _pin_isr[pin]();
+        }
+    }
 }
 
 extern "C" {
 char* ultoa(unsigned long value, char *string, int radix)
 {
-  char tmp[33];
+  char tmp[sizeof(unsigned long) * 8 + 1];
   char *tp = tmp;
   long i;
   unsigned long v = value;
@@ -45,4 +141,15 @@ char* ultoa(unsigned long value, char *string, int radix)
 
   return string;
 }
-}
\ No newline at end of file
+
+char* ltoa(long value, char *string, int radix)
+{
+  if (string != NULL && value < 0 && radix == 10)
+  {
+    string[0] = '-';
+    ultoa(-(unsigned long) value, string + 1, radix);
+    return string;
+  }
+  return ultoa(value, string, radix);
+}
+}
@@ -8,9 +8,36 @@
 #define PROGMEM
 #define F(str) (str)
 
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define digitalPinToInterrupt(p) (p)
+
 unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+// test helper, drive level of emulated input pin and fire attached interrupt
+void emu_setPin(uint8_t pin, int level);
+
+// virtual clock, millis(), micros() and delay() use simulated time that only advances
+// through delay() and emu_advanceClock() while enabled
+void emu_setVirtualClock(bool enable);
+bool emu_isVirtualClock();
+void emu_advanceClock(unsigned long us);
 
 extern "C" {
+char* ltoa(long value, char *string, int radix);
 char* ultoa(unsigned long value, char *string, int radix);
 }
 
@@ -1,91 +1,516 @@
 
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
 #include "SerialEmu.h"
 
+const emu_delay_t emu_tile_delays[] = {
+    { "$MT C=U", 250000, 100000 },      // counts messages in outbox database
+    { "$MT L=", 300000, 100000 },
+    { "$MT D=", 150000, 50000 },
+    { "$MM D=", 150000, 50000 },
+    { "$TD", 40000, 20000 },            // stores message in outbox database
+    { "$MM", 20000, 10000 },
+    { "$RS", 0, 0 },                    // answered before reset
+    { "$", 3000, 1000 },
+    { 0, 0, 0 }
+};
+
 SerialBuffer::SerialBuffer()
 {
     memset(_buffer, 0, sizeof(_buffer));
+    memset(_ready_us, 0, sizeof(_ready_us));
+    _last_ready_us = 0;
     _read_pos = 0;
     _write_pos = 0;
+    _waiters = 0;
+    _wakeup = false;
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_cond, NULL);
 }
 
-void SerialBuffer::_inc_read_pos() {
-    pthread_mutex_lock(&_mutex);
-    _read_pos++;
-    if (_read_pos >= sizeof(_buffer)) {
-        printf("reset r ");
-        _read_pos = 0;
+SerialBuffer::~SerialBuffer()
+{
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+size_t SerialBuffer::available()
+{
+    size_t read_pos = _read_pos.load(std::memory_order_acquire);
+    size_t ret = _write_pos.load(std::memory_order_acquire) - read_pos;
+
+    if (ret > 0 && _last_ready_us.load(std::memory_order_relaxed) > micros()) {
+        // some bytes are still on the wire, arrival times are ascending
+        unsigned long now = micros();
+        size_t arrived = 0;
+        while (arrived < ret && _ready_us[(read_pos + arrived) % EMU_BUFFER_LEN] <= now) {
+            arrived++;
+        }
+        ret = arrived;
     }
-    pthread_mutex_unlock(&_mutex);
+    return ret;
 }
 
-void SerialBuffer::_inc_write_pos() {
-    pthread_mutex_lock(&_mutex);
-    _write_pos++;
-    if (_write_pos >= sizeof(_buffer)) {
-        printf("reset w ");
-        _write_pos = 0;
+unsigned long SerialBuffer::nextArrival()
+{
+    unsigned long now = micros();
+    size_t read_pos = _read_pos.load(std::memory_order_acquire);
+    size_t count = _write_pos.load(std::memory_order_acquire) - read_pos;
+
+    if (_last_ready_us.load(std::memory_order_relaxed) <= now) {
+        return 0;
     }
-    pthread_mutex_unlock(&_mutex);
+    for (size_t i = 0; i < count; i++) {
+        unsigned long ready_us = _ready_us[(read_pos + i) % EMU_BUFFER_LEN];
+        if (ready_us > now) {
+            return ready_us;
+        }
+    }
+    return 0;
 }
 
-size_t SerialBuffer::available()
+size_t SerialBuffer::write(const char *buffer, size_t size, unsigned long start_us, unsigned long byte_us)
 {
-    size_t ret;
-    pthread_mutex_lock(&_mutex);
-    if (_read_pos <= _write_pos) {
-        ret = _write_pos - _read_pos;
-    } else {
-        ret = sizeof(_buffer) - _read_pos + _write_pos;
+    size_t write_pos = _write_pos.load(std::memory_order_relaxed);
+    size_t space = EMU_BUFFER_LEN - (write_pos - _read_pos.load(std::memory_order_acquire));
+
+    if (size > space) {
+        // reader fell behind, drop what doesn't fit like a UART overrun
+        size = space;
     }
-    pthread_mutex_unlock(&_mutex);
-    return ret;
+    if (size == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        size_t pos = (write_pos + i) % EMU_BUFFER_LEN;
+        _buffer[pos] = buffer[i];
+        _ready_us[pos] = start_us + (i + 1) * byte_us;
+    }
+    _last_ready_us.store(start_us + size * byte_us, std::memory_order_relaxed);
+    _write_pos.store(write_pos + size, std::memory_order_release);
+    _notify();
+    return size;
 }
 
-size_t SerialBuffer::write(const char *buffer, size_t size, bool overwrite)
+size_t SerialBuffer::read(char *buffer, size_t size)
 {
-    size_t written = 0;
-    while (size > 0) {
-        _buffer[_write_pos] = *buffer;
-        _inc_write_pos();
-        written++;
-        buffer++;
-        size--;
+    size_t count = available();
+    size_t read_pos = _read_pos.load(std::memory_order_relaxed);
+
+    if (size > count) {
+        size = count;
     }
-    return written;
+    // copy in up to two chunks around the end of the ring
+    size_t pos = read_pos % EMU_BUFFER_LEN;
+    size_t first = EMU_BUFFER_LEN - pos;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(buffer, _buffer + pos, first);
+    memcpy(buffer + first, _buffer, size - first);
+    _read_pos.store(read_pos + size, std::memory_order_release);
+    return size;
 }
 
 int SerialBuffer::read()
 {
-    int c = -1;
-    if (available()) {
-        c = _buffer[_read_pos];
-        _inc_read_pos();
+    char c;
+    if (read(&c, 1) == 0) {
+        return -1;
     }
-    return c;
+    return (uint8_t) c;
 }
 
 int SerialBuffer::peek()
 {
-    int c = -1;
+    if (available() == 0) {
+        return -1;
+    }
+    return (uint8_t) _buffer[_read_pos.load(std::memory_order_relaxed) % EMU_BUFFER_LEN];
+}
+
+bool SerialBuffer::wait(unsigned long timeout_us)
+{
     if (available()) {
-        c = _buffer[_read_pos];
+        return true;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    // writer checks _waiters after publishing bytes, see _notify
+    _waiters.fetch_add(1);
+    pthread_mutex_lock(&_mutex);
+    while (!_wakeup && _write_pos.load() == _read_pos.load(std::memory_order_relaxed)) {
+        if (pthread_cond_timedwait(&_cond, &_mutex, &deadline) != 0) {
+            break;
+        }
+    }
+    _wakeup = false;
+    pthread_mutex_unlock(&_mutex);
+    _waiters.fetch_sub(1);
+
+    if (!available() && !emu_isVirtualClock()) {
+        // bytes still on the wire
+        unsigned long next = nextArrival();
+        unsigned long now = micros();
+        if (next > now) {
+            usleep(next - now < timeout_us ? next - now : timeout_us);
+        }
+    }
+    return available() > 0;
+}
+
+void SerialBuffer::wakeup()
+{
+    pthread_mutex_lock(&_mutex);
+    _wakeup = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void SerialBuffer::_notify()
+{
+    // order publishing of _write_pos before reading _waiters
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiters.load(std::memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&_mutex);
+        pthread_cond_broadcast(&_cond);
+        pthread_mutex_unlock(&_mutex);
     }
-    return c;
 }
 
 SerialEmu::SerialEmu()
 {
+    _byte_us = 0;
+    _delays = 0;
+    _emu_busy = false;
+    _tx_free_us = 0;
+    _tx_line_len = 0;
+    pthread_mutex_init(&_pending_mutex, NULL);
+    _busy_us = 0;
+    _pending_count = 0;
+    _rx_free_us = 0;
+    _rx_line_start = true;
+    _faults = 0;
+    _fault_line_len = 0;
+    setSeed(1);
+    resetFaultStats();
+}
+
+SerialEmu::~SerialEmu()
+{
+    pthread_mutex_destroy(&_pending_mutex);
+}
+
+void SerialEmu::setBaudRate(uint32_t baud)
+{
+    // start bit, 8 data bits, stop bit
+    _byte_us = baud ? (10 * 1000000UL + baud / 2) / baud : 0;
+}
+
+void SerialEmu::setDelays(const emu_delay_t *delays)
+{
+    pthread_mutex_lock(&_pending_mutex);
+    _delays = delays;
+    _pending_count = 0;
+    pthread_mutex_unlock(&_pending_mutex);
+}
+
+void SerialEmu::setSeed(uint32_t seed)
+{
+    // separate streams for the library and the Tile side, each is used by one thread
+    _fault_seed = seed ? seed : 1;
+    _delay_seed = _fault_seed ^ 0x9e3779b9;
+    if (_delay_seed == 0) {
+        _delay_seed = 1;
+    }
+}
+
+void SerialEmu::wait(uint32_t ms)
+{
+    if (!emu_isVirtualClock()) {
+        _rx_buffer.wait(ms * 1000UL);
+        return;
+    }
+
+    // let Tile side catch up on commands that already arrived
+    struct timespec real_start, real_now;
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    while (_tx_buffer.available() || _emu_busy) {
+        clock_gettime(CLOCK_MONOTONIC, &real_now);
+        if ((real_now.tv_sec - real_start.tv_sec) * 1000 +
+            (real_now.tv_nsec - real_start.tv_nsec) / 1000000 > EMU_IDLE_WAIT_MS) {
+            // nobody is reading, e.g. emulated sequence ended
+            break;
+        }
+        sched_yield();
+    }
+    if (_rx_buffer.available()) {
+        return;
+    }
+
+    // jump to next byte arrival, TILE_TIMEOUT_CHECK expires after more than ms
+    unsigned long now = micros();
+    unsigned long until = now + (ms + 1) * 1000UL;
+    unsigned long rx = _rx_buffer.nextArrival();
+    unsigned long tx = _tx_buffer.nextArrival();
+    if (rx != 0 && rx < until) {
+        until = rx;
+    }
+    if (tx != 0 && tx < until) {
+        until = tx;
+    }
+    emu_advanceClock(until - now);
+}
+
+void SerialEmu::emu_idle()
+{
+    _emu_busy = false;
+}
+
+void SerialEmu::setFaults(const emu_faults_t *faults)
+{
+    _faults = faults;
+    _fault_line_len = 0;
+}
+
+void SerialEmu::getFaultStats(emu_fault_stats_t &stats)
+{
+    stats = _fault_stats;
+}
+
+void SerialEmu::resetFaultStats()
+{
+    memset(&_fault_stats, 0, sizeof(_fault_stats));
+}
+
+// xorshift32
+uint32_t SerialEmu::_random(uint32_t &seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// used by the fault injector on the Tile side
+bool SerialEmu::_chance(float probability)
+{
+    return probability > 0 && _random(_fault_seed) < probability * 4294967296.0;
+}
+
+void SerialEmu::_deliverSentence(const char *sentence)
+{
+    char buf[100];
+    uint8_t cs = 0;
+    for (const char *c = sentence + 1; *c; c++) {
+        cs ^= (uint8_t) *c;
+    }
+    snprintf(buf, sizeof(buf), "%s*%02x\n", sentence, cs);
+    _deliver(buf, strlen(buf));
+}
+
+void SerialEmu::_injectFaults(const char *line, size_t len)
+{
+    static const char *const boot[] = {
+        "$M138 BOOT,RESTART",
+        "$M138 BOOT,POWERON,LPWR=n,WDOG=y,BROWN=n,PIN=n,SW=n",
+        "$M138 BOOT,VERSION,2021-11-04-16:33:05,v1.1.0",
+        "$M138 BOOT,RUNNING",
+        0
+    };
+    char buf[EMU_FAULT_LINE_LEN];
+    size_t n = 0;
+
+    _fault_stats.lines++;
+    if (_chance(_faults->reboot)) {
+        // line is lost with the reboot
+        _fault_stats.reboots++;
+        for (int i = 0; boot[i]; i++) {
+            _deliverSentence(boot[i]);
+        }
+        return;
+    }
+    if (_chance(_faults->burst)) {
+        _fault_stats.bursts++;
+        for (uint8_t i = 0; i < _faults->burst_len; i++) {
+            _deliverSentence("$RT RSSI=-104");
+        }
+    }
+    if (_chance(_faults->delay)) {
+        _fault_stats.delayed++;
+        unsigned long until = micros() + _faults->delay_us;
+        if (until > _rx_free_us) {
+            _rx_free_us = until;
+        }
+    }
+    if (len > 1 && _chance(_faults->truncate)) {
+        _fault_stats.truncated++;
+        len = 1 + _random(_fault_seed) % (len - 1);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (_chance(_faults->drop)) {
+            _fault_stats.dropped++;
+            continue;
+        }
+        buf[n] = line[i];
+        if (_chance(_faults->flip)) {
+            _fault_stats.flipped++;
+            buf[n] ^= 1 << (_random(_fault_seed) % 8);
+        }
+        n++;
+    }
+
+    _deliver(buf, n);
+    if (_chance(_faults->duplicate)) {
+        _fault_stats.duplicated++;
+        _deliver(buf, n);
+    }
+}
+
+// bytes can't go onto the wire before the previous byte is done
+unsigned long SerialEmu::_start_us(unsigned long free_us)
+{
+    unsigned long now = micros();
+    return free_us > now ? free_us : now;
+}
+
+uint32_t SerialEmu::_delay(const char *line)
+{
+    for (const emu_delay_t *d = _delays; d && d->command; d++) {
+        if (strncmp(line, d->command, strlen(d->command)) != 0) {
+            continue;
+        }
+        if (d->jitter_us == 0) {
+            return d->delay_us;
+        }
+        uint32_t offset = _random(_delay_seed) % (2 * d->jitter_us + 1);
+        if (d->delay_us + offset < d->jitter_us) {
+            return 0;
+        }
+        return d->delay_us + offset - d->jitter_us;
+    }
+    return 0;
+}
+
+// command line fully arrived at Tile at end_us
+void SerialEmu::_commandSent(unsigned long end_us)
+{
+    if (_tx_line_len < 3 || _tx_line[0] != '$') {
+        return;
+    }
+    uint32_t delay_us = _delay(_tx_line);
+
+    pthread_mutex_lock(&_pending_mutex);
+    if (_pending_count == EMU_MAX_PENDING) {
+        // Tile never answered oldest command
+        memmove(&_pending[0], &_pending[1], sizeof(_pending_t) * (EMU_MAX_PENDING - 1));
+        _pending_count--;
+    }
+
+    _pending_t &p = _pending[_pending_count++];
+    memcpy(p.command, _tx_line, 3);
+    p.command[3] = 0;
+    _busy_us = (_busy_us > end_us ? _busy_us : end_us) + delay_us;
+    p.done_us = _busy_us;
+    pthread_mutex_unlock(&_pending_mutex);
+}
+
+// earliest start of a response line, unsolicited messages match no command and start at once
+unsigned long SerialEmu::_responseStart(const char *buffer, size_t size)
+{
+    unsigned long done_us = 0;
+
+    if (size < 3) {
+        return 0;
+    }
+    pthread_mutex_lock(&_pending_mutex);
+    for (uint8_t i = 0; i < _pending_count; i++) {
+        if (strncmp(_pending[i].command, buffer, 3) == 0) {
+            done_us = _pending[i].done_us;
+            memmove(&_pending[i], &_pending[i + 1], sizeof(_pending_t) * (_pending_count - i - 1));
+            _pending_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_pending_mutex);
+    return done_us;
 }
 
 size_t SerialEmu::_append_tx(const char *buffer, size_t size)
 {
-    return _tx_buffer.write(buffer, size);
+    if (_byte_us == 0 && _delays == 0) {
+        return _tx_buffer.write(buffer, size);
+    }
+
+    unsigned long start_us = _start_us(_tx_free_us);
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] == '\n') {
+            _tx_line[_tx_line_len] = 0;
+            _commandSent(start_us + (i + 1) * _byte_us);
+            _tx_line_len = 0;
+        } else if (_tx_line_len < sizeof(_tx_line) - 1) {
+            _tx_line[_tx_line_len++] = buffer[i];
+        }
+    }
+    _tx_free_us = start_us + size * _byte_us;
+    return _tx_buffer.write(buffer, size, start_us, _byte_us);
 }
 
 size_t SerialEmu::_append_rx(const char *buffer, size_t size)
 {
-    return _rx_buffer.write(buffer, size);
+    if (_faults == 0) {
+        return _deliver(buffer, size);
+    }
+
+    // collect complete lines for the fault injector
+    for (size_t i = 0; i < size; i++) {
+        if (_fault_line_len < sizeof(_fault_line)) {
+            _fault_line[_fault_line_len++] = buffer[i];
+        }
+        if (buffer[i] == '\n') {
+            _injectFaults(_fault_line, _fault_line_len);
+            _fault_line_len = 0;
+        }
+    }
+    return size;
+}
+
+size_t SerialEmu::_deliver(const char *buffer, size_t size)
+{
+    if (_byte_us == 0 && _delays == 0 && _rx_free_us <= micros()) {
+        return _rx_buffer.write(buffer, size);
+    }
+
+    // write line by line, each response waits for the Tile to process its command
+    size_t written = 0;
+    while (written < size) {
+        const char *line = buffer + written;
+        const char *end = (const char*) memchr(line, '\n', size - written);
+        size_t len = end ? end - line + 1 : size - written;
+
+        unsigned long start_us = _start_us(_rx_free_us);
+        if (_rx_line_start) {
+            unsigned long done_us = _responseStart(line, len);
+            if (done_us > start_us) {
+                start_us = done_us;
+            }
+        }
+        written += _rx_buffer.write(line, len, start_us, _byte_us);
+        _rx_free_us = start_us + len * _byte_us;
+        _rx_line_start = end != 0;
+    }
+    return written;
 }
 
 int SerialEmu::available()
@@ -110,9 +535,7 @@ size_t SerialEmu::write(const uint8_t *buffer, size_t size)
 
 size_t SerialEmu::write(uint8_t ch)
 {
-    char buf[10];
-    snprintf(buf, sizeof(buf), "%c", ch);
-    return _append_tx(buf, strlen(buf));
+    return _append_tx((const char*) &ch, 1);
 }
 
 int SerialEmu::emu_available()
@@ -122,7 +545,30 @@ int SerialEmu::emu_available()
 
 int SerialEmu::emu_read()
 {
-    return _tx_buffer.read();
+    int c = _tx_buffer.read();
+    if (c == '\n') {
+        _emu_busy = true;
+    }
+    return c;
+}
+
+size_t SerialEmu::emu_read(char *buffer, size_t size)
+{
+    size_t len = _tx_buffer.read(buffer, size);
+    if (memchr(buffer, '\n', len)) {
+        _emu_busy = true;
+    }
+    return len;
+}
+
+bool SerialEmu::emu_wait(unsigned long timeout_us)
+{
+    return _tx_buffer.wait(timeout_us);
+}
+
+void SerialEmu::emu_wakeup()
+{
+    _tx_buffer.wakeup();
 }
 
 int SerialEmu::emu_peek()
@@ -132,9 +578,7 @@ int SerialEmu::emu_peek()
 
 size_t SerialEmu::emu_write(uint8_t ch)
 {
-    char buf[10];
-    snprintf(buf, sizeof(buf), "%c", ch);
-    return _append_rx(buf, strlen(buf));
+    return _append_rx((const char*) &ch, 1);
 }
 
 size_t SerialEmu::emu_write(const uint8_t *buffer, size_t size)
@@ -146,10 +590,3 @@ size_t SerialEmu::emu_write(const char *buffer)
 {
     return _append_rx(buffer, strlen(buffer));
 }
-
-// to keep the linker happy..
-size_t Print::write(const uint8_t *buffer, size_t size)
-{
-    printf("Print::write shouldn't be called\n");
-    return size;
-}
@@ -2,32 +2,88 @@
 #ifndef _SERIAL_EMU_H
 #define _SERIAL_EMU_H
 
+#include <atomic>
 #include <pthread.h>
 #include "Arduino.h"
 #include "Stream.h"
 
 #define EMU_BUFFER_LEN 10000
+#define EMU_DEFAULT_BAUD 115200
+#define EMU_MAX_PENDING 16      // commands the link model tracks until the Tile answers them
+#define EMU_FAULT_LINE_LEN 1024 // longest Tile line the fault injector handles as a whole
+#define EMU_IDLE_WAIT_MS 50     // real time granted to the Tile side before virtual time advances
 
+// processing time of a command inside the Tile, from the end of the command line to the
+// start of its response, see SerialEmu::setDelays
+typedef struct {
+    const char *command;    // command prefix, e.g. "$MT C=U", 0 terminates table
+    uint32_t delay_us;      // mean processing time
+    uint32_t jitter_us;     // processing time varies uniformly by +/- jitter_us
+} emu_delay_t;
+
+// faults injected into Tile output, probabilities from 0 to 1, see SerialEmu::setFaults
+typedef struct {
+    float drop;             // per byte, byte gets lost
+    float flip;             // per byte, one bit gets inverted
+    float truncate;         // per line, rest of line including newline gets lost
+    float duplicate;        // per line, line is sent twice
+    float burst;            // per line, burst_len unsolicited sentences precede line
+    uint8_t burst_len;
+    float delay;            // per line, line is held back by delay_us
+    uint32_t delay_us;
+    float reboot;           // per line, Tile sends its boot messages instead of line
+} emu_faults_t;
+
+typedef struct {
+    uint32_t lines;         // lines of Tile output seen by injector
+    uint32_t dropped;
+    uint32_t flipped;
+    uint32_t truncated;
+    uint32_t duplicated;
+    uint32_t bursts;
+    uint32_t delayed;
+    uint32_t reboots;
+} emu_fault_stats_t;
+
+// rough processing times of a Tile, replace with measurements of your own Tile as needed
+extern const emu_delay_t emu_tile_delays[];
+
+// single producer, single consumer ring, one thread writes and one thread reads without locks
 class SerialBuffer {
 public:
     SerialBuffer();
-    size_t write(const char* buffer, size_t size, bool overwrite = true);
+    ~SerialBuffer();
+    // bytes become available one byte_us after another, the first at start_us + byte_us,
+    // returns number of bytes written, which is less than size when the ring is full
+    size_t write(const char* buffer, size_t size, unsigned long start_us = 0, unsigned long byte_us = 0);
     int read();
+    size_t read(char *buffer, size_t size);
     int peek();
     size_t available();
+    unsigned long nextArrival();    // micros() when next byte on the wire arrives, 0 if none
+    bool wait(unsigned long timeout_us);    // block reader until bytes arrive, false on timeout
+    void wakeup();                  // release a blocked reader
 private:
-    void _inc_read_pos();
-    void _inc_write_pos();
+    void _notify();
 
-    pthread_mutex_t _mutex;
     char _buffer[EMU_BUFFER_LEN];
-    volatile size_t _read_pos;
-    volatile size_t _write_pos;
+    unsigned long _ready_us[EMU_BUFFER_LEN];    // micros() when byte arrives at receiver
+    std::atomic<unsigned long> _last_ready_us;  // arrival of last byte written
+    // free running positions, the consumer owns _read_pos and the producer _write_pos
+    std::atomic<size_t> _read_pos;
+    std::atomic<size_t> _write_pos;
+
+    // blocking waits only, the data path doesn't lock
+    std::atomic<int> _waiters;
+    bool _wakeup;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
 };
 
 class SerialEmu : public Stream {
 public:
     SerialEmu();
+    ~SerialEmu();
 
     virtual int available();
     virtual int read();
@@ -37,10 +93,32 @@ public:
 
     virtual int emu_available();
     virtual int emu_read();
+    size_t emu_read(char *buffer, size_t size);
     virtual int emu_peek();
     virtual size_t emu_write(uint8_t);
     virtual size_t emu_write(const uint8_t *buffer, size_t size);
     virtual size_t emu_write(const char *buffer);
+    bool emu_wait(unsigned long timeout_us);    // block Tile side until a command arrives
+    void emu_wakeup();
+
+    // link model, bytes take 10 bit times on the wire, 0 delivers them instantly (default)
+    void setBaudRate(uint32_t baud = EMU_DEFAULT_BAUD);
+    // processing time per command, first matching prefix applies, 0 disables
+    void setDelays(const emu_delay_t *delays);
+    void setSeed(uint32_t seed);
+    // corrupt Tile output, 0 disables, faults must stay valid while set
+    void setFaults(const emu_faults_t *faults);
+    void getFaultStats(emu_fault_stats_t &stats);
+    void resetFaultStats();
+
+    // wait until bytes arrive or ms elapse, with a virtual clock jumps straight to the next
+    // byte arrival once the Tile side processed all commands, see SwarmTile::setWaitHook
+    void wait(uint32_t ms);
+    static void waitHook(void *context, uint32_t timeout_ms) {
+        ((SerialEmu*) context)->wait(timeout_ms);
+    }
+    // called by the Tile side after it handled a command line
+    void emu_idle();
 
 protected:
     size_t _append_rx(const char *buffer, size_t size);
@@ -48,6 +126,48 @@ protected:
 
     SerialBuffer _rx_buffer;
     SerialBuffer _tx_buffer;
+
+private:
+    typedef struct {
+        char command[4];        // e.g. "$MT", responses are matched by this prefix
+        unsigned long done_us;  // micros() when Tile starts to respond
+    } _pending_t;
+
+    uint32_t _byte_us;
+    const emu_delay_t *_delays;
+    std::atomic<bool> _emu_busy;    // Tile side read a command line and didn't finish it yet
+
+    // library -> Tile
+    unsigned long _tx_free_us;      // end of last byte on the wire
+    char _tx_line[32];              // start of command line being written
+    size_t _tx_line_len;
+    // commands in flight, written by the library thread and consumed by the Tile side
+    pthread_mutex_t _pending_mutex;
+    unsigned long _busy_us;         // Tile processes one command at a time
+    _pending_t _pending[EMU_MAX_PENDING];
+    uint8_t _pending_count;
+    uint32_t _delay_seed;           // processing time jitter, library thread
+
+    // Tile -> library
+    unsigned long _rx_free_us;
+    bool _rx_line_start;
+
+    // fault injection on Tile output, works on complete lines
+    const emu_faults_t *_faults;
+    emu_fault_stats_t _fault_stats;
+    char _fault_line[EMU_FAULT_LINE_LEN];
+    size_t _fault_line_len;
+    uint32_t _fault_seed;           // Tile side
+
+    unsigned long _start_us(unsigned long free_us);
+    void _commandSent(unsigned long end_us);
+    uint32_t _delay(const char *line);
+    unsigned long _responseStart(const char *buffer, size_t size);
+    size_t _deliver(const char *buffer, size_t size);
+    void _injectFaults(const char *line, size_t len);
+    void _deliverSentence(const char *sentence);
+    static uint32_t _random(uint32_t &seed);
+    bool _chance(float probability);
 };
 
 #endif
@@ -1,4 +1,5 @@
 
+#include <stdlib.h>
 #include "TileEmu.h"
 
 TileEmu::TileEmu(SerialEmu &serial) : _serial(serial)
@@ -7,6 +8,7 @@ TileEmu::TileEmu(SerialEmu &serial) : _serial(serial)
     _step = 0;
     _sequence = 0;
     _verbose = false;
+    _next_error = ERR_NONE;
 }
 
 void TileEmu::flush()
@@ -14,6 +16,7 @@ void TileEmu::flush()
     while (_serial.emu_available()) {
         _serial.emu_read();
     }
+    _serial.emu_idle();
 }
 
 void TileEmu::setVerbose(bool verbose)
@@ -25,11 +28,18 @@ void TileEmu::setSequence(emu_sequence_t *sequence)
 {
     _step = 0;
     _sequence = sequence;
+    _exit = false;
+}
+
+void TileEmu::setNextError(emu_err_t err)
+{
+    _next_error = err;
 }
 
 void TileEmu::stop()
 {
     _exit = true;
+    _serial.emu_wakeup();
 }
 
 void *TileEmu::_run()
@@ -41,31 +51,37 @@ void *TileEmu::_run()
 
     _step = 0;
 
-    char ch;
+    char buf[256];
     char line[1000];
     size_t i = 0;
-    _exit = false;
     while (_exit == false) {
-        if (_serial.emu_available()) {
-            ch = _serial.emu_read();
-            line[i++] = ch;
+        size_t len = _serial.emu_read(buf, sizeof(buf));
+        if (len == 0) {
+            // sleep until library sends more, stop() wakes us up
+            _serial.emu_wait(TILE_EMU_WAIT_US);
+            continue;
+        }
+        for (size_t k = 0; k < len; k++) {
+            line[i++] = buf[k];
             if (i >= sizeof(line)) {
                 // overflow of line buffer
-                break;
+                return 0;
             }
-            if (ch == '\n') {
+            if (buf[k] == '\n') {
                 line[i] = 0;
                 _process_line(line);
                 _step++;
                 if (_sequence[_step].expected == 0) {
                     // last step in expected sequence
-                    break;
+                    _serial.emu_idle();
+                    return 0;
                 } else {
                     // process next command
                     i = 0;
                 }
             }
         }
+        _serial.emu_idle();
     }
 
     return 0;
@@ -95,21 +111,36 @@ void TileEmu::_process_line(const char* line)
             }
         }
 
-        if (found == true) {
-            if (_sequence[_step].response) {
-                _serial.emu_write(_sequence[_step].response);
-                if (_verbose) {
-                    printf("<< %s", _sequence[_step].response);
-                }
-                if (_sequence[_step].response[strlen(_sequence[_step].response)-1] != '\n') {
-                    // append checksum and newline to response
-                    snprintf(cs_str, sizeof(cs_str), "*%02x\n", _nmeaChecksum(_sequence[_step].response, strlen(_sequence[_step].response)));
-                    _serial.emu_write(cs_str);
-                    if (_verbose) {
-                        printf(cs_str);
-                    }
+        if (found == true && _sequence[_step].response) {
+            const char *r = _sequence[_step].response;
+            size_t len = strlen(r);
+            char *response = (char*) malloc(len + sizeof(cs_str));
+            if (len > 0 && r[len-1] == '\n') {
+                strcpy(response, r);
+            } else {
+                // append checksum and newline to response
+                sprintf(response, "%s*%02x\n", r, _nmeaChecksum(r, len));
+            }
+
+            emu_err_t err = _next_error;
+            _next_error = ERR_NONE;
+            if (err == ERR_TIMEOUT) {
+                // Tile doesn't answer
+                free(response);
+                return;
+            }
+            if (err == ERR_CRC) {
+                char *cs = strrchr(response, '*');
+                if (cs && cs[1]) {
+                    cs[1] = cs[1] == '0' ? '1' : '0';
                 }
             }
+
+            _serial.emu_write(response);
+            if (_verbose) {
+                printf("<< %s", response);
+            }
+            free(response);
         }
     }
 }
@@ -4,6 +4,8 @@
 
 #include "SerialEmu.h"
 
+#define TILE_EMU_WAIT_US 100000     // longest idle wait, stop() ends it early
+
 typedef enum {
     ERR_NONE = 0,
     ERR_TIMEOUT,
@@ -25,7 +27,7 @@ public:
     void flush();
     void setVerbose(bool verbose);
     void setSequence(emu_sequence_t *sequence);
-    void setNextError(emu_err_t err);
+    void setNextError(emu_err_t err);   // next response is withheld or gets a wrong checksum
 
 private:
     SerialEmu &_serial;
@@ -33,6 +35,7 @@ private:
     uint8_t _step;
     emu_sequence_t *_sequence;
     bool _verbose;
+    emu_err_t _next_error;
 
     void *_run();
     void _process_line(const char *line);
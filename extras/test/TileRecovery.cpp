@@ -0,0 +1,58 @@
+
+#include <string.h>
+#include "TileRecovery.h"
+
+TileRecovery::TileRecovery()
+{
+    reset();
+}
+
+void TileRecovery::reset()
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.recovered = true;
+    _call_us = 0;
+    _failed_us = 0;
+    _failed_ops = 0;
+    _recovery_sum_us = 0;
+}
+
+void TileRecovery::begin()
+{
+    _call_us = micros();
+}
+
+void TileRecovery::end(bool correct)
+{
+    _stats.operations++;
+
+    if (!correct) {
+        _stats.failures++;
+        if (_failed_ops == 0) {
+            _failed_us = _call_us;
+        }
+        _failed_ops++;
+        if (_failed_ops > _stats.max_failed_ops) {
+            _stats.max_failed_ops = _failed_ops;
+        }
+        _stats.recovered = false;
+        return;
+    }
+
+    if (_failed_ops > 0) {
+        unsigned long recovery_us = micros() - _failed_us;
+        _stats.recoveries++;
+        _recovery_sum_us += recovery_us;
+        _stats.mean_recovery_us = _recovery_sum_us / _stats.recoveries;
+        if (recovery_us > _stats.max_recovery_us) {
+            _stats.max_recovery_us = recovery_us;
+        }
+        _failed_ops = 0;
+    }
+    _stats.recovered = true;
+}
+
+void TileRecovery::getStats(tile_recovery_stats_t &stats)
+{
+    stats = _stats;
+}
@@ -0,0 +1,37 @@
+
+#ifndef _TILE_RECOVERY_H
+#define _TILE_RECOVERY_H
+
+#include "Arduino.h"
+
+typedef struct {
+    uint32_t operations;            // library calls recorded
+    uint32_t failures;              // calls with wrong or missing result
+    uint32_t recoveries;            // returns to correct results after failures
+    uint32_t max_failed_ops;        // longest run of failed calls
+    unsigned long mean_recovery_us; // from start of first failed call to end of next correct call
+    unsigned long max_recovery_us;
+    bool recovered;                 // last call was correct
+} tile_recovery_stats_t;
+
+// Measures how long the library takes to get back to correct results after
+// injected faults. Record every call in order, bracketed by begin() and end().
+class TileRecovery {
+public:
+    TileRecovery();
+    void reset();
+
+    void begin();           // before each library call
+    void end(bool correct); // after it, correct if result and returned data are as expected
+
+    void getStats(tile_recovery_stats_t &stats);
+
+private:
+    tile_recovery_stats_t _stats;
+    unsigned long _call_us;         // micros() when current call started
+    unsigned long _failed_us;       // micros() when first failed call of current run started
+    uint32_t _failed_ops;           // failed calls in current run
+    uint64_t _recovery_sum_us;
+};
+
+#endif
@@ -0,0 +1,261 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "TileReplay.h"
+
+TileReplay::TileReplay(SerialEmu &serial) : _serial(serial)
+{
+    _exit = false;
+    _trace = 0;
+    _speed = 1;
+    pthread_mutex_init(&_mutex, NULL);
+    memset(&_stats, 0, sizeof(_stats));
+    _mismatch[0] = 0;
+}
+
+TileReplay::~TileReplay()
+{
+    free(_trace);
+    pthread_mutex_destroy(&_mutex);
+}
+
+void TileReplay::stop()
+{
+    _exit = true;
+    _serial.emu_wakeup();
+}
+
+bool TileReplay::load(const char *trace)
+{
+    const char *pos = trace;
+    uint32_t line = 0;
+    bool valid = true;
+    _record_t record;
+
+    while (_parse(pos, line, record, valid)) {
+        if (!valid) {
+            return false;
+        }
+    }
+
+    free(_trace);
+    _trace = strdup(trace);
+    return true;
+}
+
+bool TileReplay::loadFile(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *trace = (char*) malloc(size + 1);
+    size_t len = fread(trace, 1, size, file);
+    trace[len] = 0;
+    fclose(file);
+
+    bool result = load(trace);
+    free(trace);
+    return result;
+}
+
+void TileReplay::setSpeed(float speed)
+{
+    _speed = speed;
+}
+
+void TileReplay::getStats(tile_replay_stats_t &stats)
+{
+    pthread_mutex_lock(&_mutex);
+    stats = _stats;
+    pthread_mutex_unlock(&_mutex);
+}
+
+void TileReplay::getMismatch(char *buf, size_t buf_len)
+{
+    pthread_mutex_lock(&_mutex);
+    snprintf(buf, buf_len, "%s", _mismatch);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void *TileReplay::_run()
+{
+    const char *pos = _trace;
+    uint32_t line = 0;
+    bool valid;
+    _record_t record;
+    char expected[TILE_REPLAY_LINE_LEN];
+    size_t expected_len = 0;
+    uint32_t expected_line = 0;
+    char received[TILE_REPLAY_LINE_LEN];
+    unsigned long last_ms = 0;      // recorded time of previous record
+    unsigned long last_us = 0;      // micros() when previous record was replayed
+    bool first = true;
+
+    _exit = false;
+    pthread_mutex_lock(&_mutex);
+    memset(&_stats, 0, sizeof(_stats));
+    _mismatch[0] = 0;
+    pthread_mutex_unlock(&_mutex);
+
+    while (!_exit && pos && _parse(pos, line, record, valid)) {
+        if (record.dir == 'R') {
+            if (!first && _speed > 0 && record.ms > last_ms) {
+                _sleepUntil(last_us + (unsigned long) ((record.ms - last_ms) * 1000 / _speed));
+            }
+            _serial.emu_write((const uint8_t*) record.data, record.len);
+            if (!record.continued) {
+                _serial.emu_write((uint8_t) '\n');
+            }
+            last_us = micros();
+
+            pthread_mutex_lock(&_mutex);
+            _stats.responses++;
+            pthread_mutex_unlock(&_mutex);
+        } else {
+            // command may be split by Tile output that interrupted it
+            if (expected_len == 0) {
+                expected_line = record.line;
+            }
+            if (expected_len + record.len < sizeof(expected)) {
+                memcpy(expected + expected_len, record.data, record.len);
+                expected_len += record.len;
+            }
+            expected[expected_len] = 0;
+            if (record.continued) {
+                last_ms = record.ms;
+                first = false;
+                continue;
+            }
+
+            bool match = _readCommand(received, sizeof(received)) && strcmp(received, expected) == 0;
+            expected_len = 0;
+            // later Tile output is timed relative to when the library actually sent the command
+            last_us = micros();
+            _serial.emu_idle();
+
+            pthread_mutex_lock(&_mutex);
+            _stats.commands++;
+            if (!match) {
+                _stats.mismatches++;
+                if (_stats.first_mismatch == 0) {
+                    _stats.first_mismatch = expected_line;
+                    snprintf(_mismatch, sizeof(_mismatch), "%s", received);
+                }
+            }
+            pthread_mutex_unlock(&_mutex);
+        }
+        last_ms = record.ms;
+        first = false;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    _stats.done = !_exit;
+    pthread_mutex_unlock(&_mutex);
+    return 0;
+}
+
+// next record from trace, skips empty lines and # comments, valid is false for malformed lines
+bool TileReplay::_parse(const char *&pos, uint32_t &line, _record_t &record, bool &valid)
+{
+    while (*pos) {
+        const char *end = strchr(pos, '\n');
+        if (!end) {
+            end = pos + strlen(pos);
+        }
+        const char *p = pos;
+        pos = *end ? end + 1 : end;
+        line++;
+        if (end > p && end[-1] == '\r') {
+            // trace edited on Windows, Tile's own \r is escaped
+            end--;
+        }
+
+        if (p == end || *p == '#') {
+            continue;
+        }
+
+        // <millis> <T|R> <sentence>
+        char *num_end;
+        record.line = line;
+        record.ms = strtoul(p, &num_end, 10);
+        if (num_end == p) {
+            valid = false;
+            return true;
+        }
+        p = num_end;
+        if (p + 3 > end || p[0] != ' ' || (p[1] != 'T' && p[1] != 'R') || p[2] != ' ') {
+            valid = false;
+            return true;
+        }
+        record.dir = p[1];
+        p += 3;
+
+        record.len = 0;
+        record.continued = false;
+        while (p < end && record.len < sizeof(record.data)) {
+            if (*p != '\\') {
+                record.data[record.len++] = *p++;
+            } else if (p + 1 == end) {
+                // continued in later record
+                record.continued = true;
+                p++;
+            } else if (p + 4 <= end && p[1] == 'x') {
+                char hex[3] = { p[2], p[3], 0 };
+                record.data[record.len++] = (char) strtoul(hex, 0, 16);
+                p += 4;
+            } else {
+                valid = false;
+                return true;
+            }
+        }
+        valid = true;
+        return true;
+    }
+    return false;
+}
+
+// next line sent by the library without newline, false if none arrives in time
+bool TileReplay::_readCommand(char *buf, size_t buf_len)
+{
+    size_t len = 0;
+    unsigned long start = millis();
+
+    buf[0] = 0;
+    while (!_exit) {
+        int c = _serial.emu_read();
+        if (c < 0) {
+            unsigned long elapsed = millis() - start;
+            if (elapsed >= TILE_REPLAY_WAIT_MS) {
+                return false;
+            }
+            _serial.emu_wait((TILE_REPLAY_WAIT_MS - elapsed) * 1000UL);
+            continue;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        if (len < buf_len - 1) {
+            buf[len++] = c;
+            buf[len] = 0;
+        }
+    }
+    return false;
+}
+
+void TileReplay::_sleepUntil(unsigned long us)
+{
+    while (!_exit) {
+        unsigned long now = micros();
+        if (now >= us) {
+            break;
+        }
+        // short slices keep stop() responsive
+        usleep(us - now < 10000 ? us - now : 10000);
+    }
+}
@@ -0,0 +1,66 @@
+
+#ifndef _TILE_REPLAY_H
+#define _TILE_REPLAY_H
+
+#include <pthread.h>
+#include "SerialEmu.h"
+#include "SwarmTile.h"
+
+#define TILE_REPLAY_LINE_LEN 1024   // longest sentence in a trace
+#define TILE_REPLAY_WAIT_MS 2000    // wait for the library to send the next recorded command
+
+typedef struct {
+    uint32_t commands;          // recorded commands the library was expected to send
+    uint32_t mismatches;        // commands that differed from the trace or didn't arrive
+    uint32_t responses;         // recorded Tile output played back
+    uint32_t first_mismatch;    // trace line of first mismatch, 0 if none
+    bool done;                  // reached end of trace
+} tile_replay_stats_t;
+
+// Plays a trace recorded with SwarmTile::setDebugStream(stream, TILE_DEBUG_TRACE)
+// back on the device side of a SerialEmu. Recorded Tile output is written with
+// its original timing divided by the speed, recorded commands are compared with
+// what the library sends.
+class TileReplay {
+public:
+    TileReplay(SerialEmu &serial);
+    ~TileReplay();
+    static void *run(void *context) {
+        return ((TileReplay*)context)->_run();
+    }
+    void stop();
+
+    // configuration, call before run
+    bool load(const char *trace);           // returns false on malformed trace line
+    bool loadFile(const char *path);
+    void setSpeed(float speed);             // 1 plays original timing, 10 ten times faster, 0 without delays
+
+    // thread safe while running
+    void getStats(tile_replay_stats_t &stats);
+    void getMismatch(char *buf, size_t buf_len);    // command received at first mismatch
+
+private:
+    typedef struct {
+        uint32_t line;          // line number in trace
+        unsigned long ms;       // millis() when recorded
+        char dir;               // 'T' sent by library, 'R' received from Tile
+        char data[TILE_REPLAY_LINE_LEN];
+        size_t len;
+        bool continued;         // line goes on in a later record, no newline
+    } _record_t;
+
+    SerialEmu &_serial;
+    volatile bool _exit;
+    char *_trace;
+    float _speed;
+    pthread_mutex_t _mutex;
+    tile_replay_stats_t _stats;
+    char _mismatch[TILE_REPLAY_LINE_LEN];
+
+    void *_run();
+    bool _parse(const char *&pos, uint32_t &line, _record_t &record, bool &valid);
+    bool _readCommand(char *buf, size_t buf_len);
+    void _sleepUntil(unsigned long us);
+};
+
+#endif
@@ -0,0 +1,552 @@
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "TileSim.h"
+
+// Tile drops unsent messages after 48 hours without HD= or ET=
+#define TILE_SIM_HOLD_DEFAULT 172800
+#define TILE_SIM_HOLD_MIN 60
+
+// periodic messages in order of _rates
+static const char *const _rate_cmds[TILE_SIM_RATE_COUNT] = {
+    "$DT", "$GN", "$GS", "$PW", "$GJ", "$RT"
+};
+
+TileSim::TileSim(SerialEmu &serial) : _serial(serial)
+{
+    pthread_mutex_init(&_mutex, NULL);
+    _exit = false;
+    _scale = 1;
+    _start_epoch = 1623385462;     // 2021-06-11 04:24:22
+    _start_ms = millis();
+    _outbox_count = 0;
+    _outbox_size = TILE_SIM_DB_SIZE;
+    _inbox_count = 0;
+    _injected_count = 0;
+    _next_id = 5354468575855;
+    _pass_interval = 3600;
+    _pass_duration = 600;
+    _pass_capacity = 20;
+    _pass_start = 0;
+    _pass_sent = 0;
+    _in_pass = false;
+    memset(_rates, 0, sizeof(_rates));
+    memset(_rate_next, 0, sizeof(_rate_next));
+    _gpio_mode = 0;
+    _sleep_until = 0;
+    _powered = true;
+    _boot_at = 0;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void TileSim::stop()
+{
+    _exit = true;
+}
+
+void TileSim::setTimeScale(uint32_t scale)
+{
+    _scale = scale;
+}
+
+void TileSim::setStartTime(uint32_t epoch)
+{
+    _start_epoch = epoch;
+}
+
+void TileSim::setPasses(uint32_t interval_s, uint32_t duration_s, uint16_t capacity)
+{
+    pthread_mutex_lock(&_mutex);
+    _pass_interval = interval_s;
+    _pass_duration = duration_s;
+    _pass_capacity = capacity;
+    if (capacity == 0) {
+        _in_pass = false;
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+void TileSim::setOutboxSize(uint16_t messages)
+{
+    _outbox_size = messages < TILE_SIM_DB_SIZE ? messages : TILE_SIM_DB_SIZE;
+}
+
+uint32_t TileSim::now()
+{
+    return _start_epoch + (uint64_t) (millis() - _start_ms) * _scale / 1000;
+}
+
+bool TileSim::inject(const char *data, uint16_t len, uint16_t app_id)
+{
+    uint16_t i;
+    bool ok = false;
+
+    pthread_mutex_lock(&_mutex);
+    if (_injected_count < TILE_SIM_DB_SIZE && len <= TILE_MAX_MSG_SIZE) {
+        _msg_t &msg = _injected[_injected_count++];
+        memset(&msg, 0, sizeof(msg));
+        msg.app_id = app_id;
+        for (i = 0; i < len; i++) {
+            snprintf(msg.hex + 2 * i, 3, "%02x", (uint8_t) data[i]);
+        }
+        ok = true;
+    }
+    pthread_mutex_unlock(&_mutex);
+    return ok;
+}
+
+void TileSim::reboot()
+{
+    pthread_mutex_lock(&_mutex);
+    _boot_at = now() + 1;
+    pthread_mutex_unlock(&_mutex);
+}
+
+void TileSim::getStats(tile_sim_stats_t &stats)
+{
+    pthread_mutex_lock(&_mutex);
+    stats = _stats;
+    pthread_mutex_unlock(&_mutex);
+}
+
+void *TileSim::_run()
+{
+    char buf[256];
+    char line[1000];
+    size_t i = 0;
+
+    _exit = false;
+    _start_ms = millis();
+    _pass_start = now() + _pass_interval;
+    _in_pass = false;
+
+    while (_exit == false) {
+        size_t len = _serial.emu_read(buf, sizeof(buf));
+        for (size_t k = 0; k < len; k++) {
+            if (i < sizeof(line) - 1) {
+                line[i++] = buf[k];
+            }
+            if (buf[k] == '\n') {
+                line[i] = 0;
+                i = 0;
+                pthread_mutex_lock(&_mutex);
+                _command(line);
+                pthread_mutex_unlock(&_mutex);
+            }
+        }
+        if (len > 0) {
+            _serial.emu_idle();
+        }
+
+        pthread_mutex_lock(&_mutex);
+        _tick();
+        pthread_mutex_unlock(&_mutex);
+
+        if (len == 0) {
+            // keeps simulated time moving while the library is quiet
+            _serial.emu_wait(100);
+        }
+    }
+
+    return 0;
+}
+
+// advance simulated state to current time
+void TileSim::_tick()
+{
+    uint32_t t = now();
+    uint16_t i;
+
+    if (_boot_at != 0 && t >= _boot_at) {
+        _boot_at = 0;
+        _boot();
+    }
+    if (!_powered) {
+        return;
+    }
+
+    if (_sleep_until != 0 && t >= _sleep_until) {
+        char dt[32];
+        _sleep_until = 0;
+        _datetime(dt, sizeof(dt), t, true);
+        _respond("$SL WAKE,TIME @ %s", dt);
+    }
+
+    // hold and expiration times
+    i = 0;
+    while (i < _outbox_count) {
+        if (t >= _outbox[i].deadline) {
+            _remove(_outbox, _outbox_count, i);
+            _stats.expired++;
+        } else {
+            i++;
+        }
+    }
+
+    // satellite pass, sends queued messages evenly over duration of pass
+    if (_pass_capacity > 0 && !_in_pass && t >= _pass_start) {
+        _in_pass = true;
+        _pass_sent = 0;
+        _stats.passes++;
+        // downlink at start of pass
+        for (i = 0; i < _injected_count && _inbox_count < TILE_SIM_DB_SIZE; i++) {
+            _msg_t &msg = _inbox[_inbox_count++];
+            msg = _injected[i];
+            msg.msg_id = _next_id++;
+            msg.epoch = t;
+            _stats.received++;
+        }
+        _injected_count = 0;
+    }
+    if (_in_pass) {
+        uint32_t elapsed = t - _pass_start;
+        uint32_t due = (uint64_t) elapsed * _pass_capacity / _pass_duration + 1;
+        while (_pass_sent < due && _pass_sent < _pass_capacity && _outbox_count > 0) {
+            _respond("$TD SENT RSSI=%d,SNR=%d,FDEV=%d,%llu", -110 + (int) (_pass_sent % 10),
+                8, -1017, (unsigned long long) _outbox[0].msg_id);
+            _remove(_outbox, _outbox_count, 0);
+            _pass_sent++;
+            _stats.sent++;
+        }
+        if (elapsed >= _pass_duration) {
+            _in_pass = false;
+            _pass_start += _pass_interval;
+        }
+    }
+
+    if (_sleep_until != 0) {
+        return;
+    }
+    for (i = 0; i < TILE_SIM_RATE_COUNT; i++) {
+        if (_rates[i] > 0 && t >= _rate_next[i]) {
+            _rate_next[i] = t + _rates[i];
+            _periodic(i);
+        }
+    }
+}
+
+void TileSim::_boot()
+{
+    _powered = true;
+    _sleep_until = 0;
+    memset(_rates, 0, sizeof(_rates));
+    _respond("$M138 BOOT,RESTART");
+    _respond("$M138 BOOT,POWERON,LPWR=n,WDOG=n,BROWN=n,PIN=y,SW=y");
+    _respond("$M138 BOOT,VERSION,2021-11-04-16:33:05,v1.1.0");
+    _respond("$M138 BOOT,RUNNING");
+    _respond("$M138 DATETIME");
+    _respond("$M138 POSITION");
+}
+
+void TileSim::_command(char *line)
+{
+    char *star = strrchr(line, '*');
+    uint8_t cs = 0;
+    char *c;
+
+    // checksum over characters between $ and *
+    if (line[0] != '$' || star == 0) {
+        _stats.bad_lines++;
+        return;
+    }
+    for (c = line + 1; c < star; c++) {
+        cs ^= (uint8_t) *c;
+    }
+    if (strtoul(star + 1, 0, 16) != cs) {
+        _stats.bad_lines++;
+        return;
+    }
+    *star = 0;
+
+    if (!_powered) {
+        return;
+    }
+    if (_sleep_until != 0) {
+        // serial activity wakes Tile, command is lost
+        char dt[32];
+        _sleep_until = 0;
+        _datetime(dt, sizeof(dt), now(), true);
+        _respond("$SL WAKE,SERIAL @ %s", dt);
+        return;
+    }
+    if (_boot_at != 0) {
+        // rebooting
+        return;
+    }
+
+    _stats.commands++;
+    char cmd[4];
+    memcpy(cmd, line, 3);
+    cmd[3] = 0;
+    const char *args = line[3] == ' ' ? line + 4 : "";
+
+    uint8_t i;
+    for (i = 0; i < TILE_SIM_RATE_COUNT; i++) {
+        if (strcmp(cmd, _rate_cmds[i]) == 0) {
+            _commandRate(i, cmd, args);
+            return;
+        }
+    }
+
+    if (strcmp(cmd, "$FV") == 0) {
+        _respond("$FV 2021-11-04-16:33:05,v1.1.0");
+    } else if (strcmp(cmd, "$CS") == 0) {
+        _respond("$CS DI=0x000e57,DN=TILE");
+    } else if (strcmp(cmd, "$GP") == 0) {
+        if (strcmp(args, "?") == 0) {
+            _respond("$GP %u", _gpio_mode);
+        } else {
+            _gpio_mode = atoi(args);
+            _respond("$GP OK");
+        }
+    } else if (strcmp(cmd, "$TD") == 0) {
+        _commandTD(args);
+    } else if (strcmp(cmd, "$MT") == 0) {
+        _commandMT(args);
+    } else if (strcmp(cmd, "$MM") == 0) {
+        _commandMM(args);
+    } else if (strcmp(cmd, "$SL") == 0) {
+        _commandSL(args);
+    } else if (strcmp(cmd, "$RS") == 0) {
+        if (strcmp(args, "dbinit") == 0) {
+            _outbox_count = 0;
+            _inbox_count = 0;
+        }
+        _respond("$RS OK");
+        _boot_at = now() + 1;
+    } else if (strcmp(cmd, "$PO") == 0) {
+        _respond("$PO OK");
+        _powered = false;
+    } else {
+        _respond("%s ERR,NOCOMMAND", cmd);
+    }
+}
+
+// $TD [AI=<app_id>,][HD=<hold>,|ET=<epoch>,]<hex>
+void TileSim::_commandTD(const char *args)
+{
+    uint32_t t = now();
+    uint32_t deadline = t + TILE_SIM_HOLD_DEFAULT;
+    uint16_t app_id = 0;
+    const char *p = args;
+
+    if (strncmp(p, "AI=", 3) == 0) {
+        app_id = strtoul(p + 3, (char**) &p, 10);
+        p++;
+    }
+    if (strncmp(p, "HD=", 3) == 0) {
+        uint32_t hold = strtoul(p + 3, (char**) &p, 10);
+        p++;
+        if (hold < TILE_SIM_HOLD_MIN || hold > TILE_SIM_HOLD_DEFAULT) {
+            _stats.rejected++;
+            _respond("$TD ERR,BADHOLDTIME,0");
+            return;
+        }
+        deadline = t + hold;
+    } else if (strncmp(p, "ET=", 3) == 0) {
+        deadline = strtoul(p + 3, (char**) &p, 10);
+        p++;
+        if (deadline <= t) {
+            _stats.rejected++;
+            _respond("$TD ERR,BADEXPIRETIME,0");
+            return;
+        }
+    }
+
+    size_t len = strlen(p);
+    if (len == 0 || len % 2 || len > TILE_MAX_MSG_SIZE * 2 || strspn(p, "0123456789abcdefABCDEF") != len) {
+        _stats.rejected++;
+        _respond("$TD ERR,BADDATA,0");
+        return;
+    }
+    if (_outbox_count >= _outbox_size) {
+        _stats.rejected++;
+        _respond("$TD ERR,DBXTOHIVEFULL,0");
+        return;
+    }
+
+    _msg_t &msg = _outbox[_outbox_count++];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_id = _next_id++;
+    msg.app_id = app_id;
+    msg.epoch = t;
+    msg.deadline = deadline;
+    strcpy(msg.hex, p);
+    _stats.accepted++;
+    _respond("$TD OK,%llu", (unsigned long long) msg.msg_id);
+}
+
+void TileSim::_commandMT(const char *args)
+{
+    uint16_t i;
+
+    if (strcmp(args, "C=U") == 0) {
+        _respond("$MT %u", _outbox_count);
+    } else if (strcmp(args, "L=U") == 0) {
+        // one line per message, followed by count
+        for (i = 0; i < _outbox_count; i++) {
+            _listMsg("$MT", _outbox[i]);
+        }
+        _respond("$MT %u", _outbox_count);
+    } else if (strcmp(args, "D=U") == 0) {
+        _respond("$MT %u", _outbox_count);
+        _outbox_count = 0;
+    } else if (strncmp(args, "D=", 2) == 0) {
+        uint64_t msg_id = strtoull(args + 2, 0, 10);
+        for (i = 0; i < _outbox_count; i++) {
+            if (_outbox[i].msg_id == msg_id) {
+                _remove(_outbox, _outbox_count, i);
+                _respond("$MT OK");
+                return;
+            }
+        }
+        _respond("$MT ERR,DBXINVMSGID");
+    } else {
+        _respond("$MT ERR,BADPARAM");
+    }
+}
+
+void TileSim::_commandMM(const char *args)
+{
+    uint16_t i;
+    uint16_t count = 0;
+
+    if (strcmp(args, "C=U") == 0) {
+        for (i = 0; i < _inbox_count; i++) {
+            count += !_inbox[i].read;
+        }
+        _respond("$MM %u", count);
+    } else if (strcmp(args, "R=O") == 0 || strcmp(args, "R=N") == 0) {
+        bool oldest = args[2] == 'O';
+        for (i = 0; i < _inbox_count; i++) {
+            _msg_t &msg = _inbox[oldest ? i : _inbox_count - 1 - i];
+            if (!msg.read) {
+                msg.read = true;
+                _listMsg("$MM", msg);
+                return;
+            }
+        }
+        _respond("$MM ERR,DBXNOMORE");
+    } else if (strcmp(args, "D=R") == 0) {
+        i = 0;
+        while (i < _inbox_count) {
+            if (_inbox[i].read) {
+                _remove(_inbox, _inbox_count, i);
+                count++;
+            } else {
+                i++;
+            }
+        }
+        _respond("$MM %u", count);
+    } else {
+        _respond("$MM ERR,BADPARAM");
+    }
+}
+
+void TileSim::_commandSL(const char *args)
+{
+    uint32_t t = now();
+
+    if (strncmp(args, "S=", 2) == 0) {
+        uint32_t seconds = strtoul(args + 2, 0, 10);
+        if (seconds < 5 || seconds > 31536000) {
+            _respond("$SL ERR,BADPARAM");
+            return;
+        }
+        _respond("$SL OK");
+        _sleep_until = t + seconds;
+    } else if (strncmp(args, "U=", 2) == 0) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        if (strptime(args + 2, "%Y-%m-%d %H:%M:%S", &tm) == 0 || (uint32_t) timegm(&tm) <= t) {
+            _respond("$SL ERR,BADPARAM");
+            return;
+        }
+        _respond("$SL OK");
+        _sleep_until = timegm(&tm);
+    } else {
+        // Tile is awake
+        _respond("$SL ERR,NOCOMMAND");
+    }
+}
+
+// "<cmd> <seconds>" sets rate, "<cmd> ?" returns rate, "<cmd> @" returns current value
+void TileSim::_commandRate(uint8_t i, const char *cmd, const char *args)
+{
+    if (strcmp(args, "@") == 0) {
+        _periodic(i);
+    } else if (strcmp(args, "?") == 0) {
+        _respond("%s %u", cmd, _rates[i]);
+    } else if (args[0] >= '0' && args[0] <= '9') {
+        _rates[i] = strtoul(args, 0, 10);
+        _rate_next[i] = now() + _rates[i];
+        _respond("%s OK", cmd);
+    } else {
+        _respond("%s ERR,BADPARAM", cmd);
+    }
+}
+
+void TileSim::_periodic(uint8_t i)
+{
+    char dt[32];
+
+    switch (i) {
+    case 0:
+        _datetime(dt, sizeof(dt), now(), false);
+        _respond("$DT %s,V", dt);
+        break;
+    case 1: _respond("$GN 37.8921,-122.0155,77,89,2"); break;
+    case 2: _respond("$GS 109,214,9,0,G3"); break;
+    case 3: _respond("$PW 3.30100,0.00000,0.00000,0.00000,31.0"); break;
+    case 4: _respond("$GJ 1,0"); break;
+    case 5: _respond("$RT RSSI=-104"); break;
+    }
+}
+
+void TileSim::_listMsg(const char *cmd, const _msg_t &msg)
+{
+    if (msg.app_id) {
+        _respond("%s AI=%u,%s,%llu,%u", cmd, msg.app_id, msg.hex, (unsigned long long) msg.msg_id, msg.epoch);
+    } else {
+        _respond("%s %s,%llu,%u", cmd, msg.hex, (unsigned long long) msg.msg_id, msg.epoch);
+    }
+}
+
+bool TileSim::_remove(_msg_t *db, uint16_t &count, uint16_t index)
+{
+    if (index >= count) {
+        return false;
+    }
+    memmove(&db[index], &db[index + 1], (count - index - 1) * sizeof(_msg_t));
+    count--;
+    return true;
+}
+
+void TileSim::_datetime(char *buf, size_t len, uint32_t epoch, bool iso)
+{
+    struct tm tm;
+    time_t t = epoch;
+    gmtime_r(&t, &tm);
+    strftime(buf, len, iso ? "%Y-%m-%d %H:%M:%S" : "%Y%m%d%H%M%S", &tm);
+}
+
+// write sentence with checksum
+void TileSim::_respond(const char *fmt, ...)
+{
+    char buf[TILE_MAX_MSG_SIZE * 2 + 64];
+    va_list ap;
+    uint8_t cs = 0;
+    size_t i;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf) - 5, fmt, ap);
+    va_end(ap);
+
+    for (i = 1; buf[i]; i++) {
+        cs ^= (uint8_t) buf[i];
+    }
+    snprintf(buf + i, 5, "*%02x\n", cs);
+    _serial.emu_write(buf);
+}
@@ -0,0 +1,107 @@
+
+#ifndef _TILE_SIM_H
+#define _TILE_SIM_H
+
+#include <pthread.h>
+#include "SerialEmu.h"
+#include "SwarmTile.h"
+
+// max messages held in each simulated database
+#define TILE_SIM_DB_SIZE 512
+// simulated rates of periodic messages: $DT, $GN, $GS, $PW, $GJ, $RT
+#define TILE_SIM_RATE_COUNT 6
+
+typedef struct {
+    uint32_t commands;      // valid commands received
+    uint32_t bad_lines;     // lines dropped for bad checksum
+    uint32_t accepted;      // messages accepted by $TD
+    uint32_t rejected;      // messages rejected by $TD
+    uint32_t sent;          // messages sent during passes
+    uint32_t expired;       // messages dropped after hold or expiration time
+    uint32_t received;      // inbound messages delivered
+    uint32_t passes;        // satellite passes started
+} tile_sim_stats_t;
+
+// Stateful Tile firmware model on the device side of a SerialEmu.
+// Unlike TileEmu it answers any command from its own state: outbound and
+// inbound message databases, sleep, reboot, periodic messages and satellite
+// passes that send queued messages with $TD SENT. Simulated time runs
+// scale times faster than real time.
+class TileSim {
+public:
+    TileSim(SerialEmu &serial);
+    static void *run(void *context) {
+        return ((TileSim*)context)->_run();
+    }
+    void stop();
+
+    // configuration, call before run
+    void setTimeScale(uint32_t scale);      // simulated seconds per real second
+    void setStartTime(uint32_t epoch);      // simulated UTC epoch when run starts
+    void setOutboxSize(uint16_t messages);  // $TD fails with DBXTOHIVEFULL beyond this
+
+    // thread safe while running
+    void setPasses(uint32_t interval_s, uint32_t duration_s, uint16_t capacity);    // capacity 0 disables passes
+    bool inject(const char *data, uint16_t len, uint16_t app_id = 0);  // delivered at start of next pass
+    void reboot();                          // reboot as after power cycle
+    uint32_t now();                         // simulated UTC epoch
+    void getStats(tile_sim_stats_t &stats);
+
+private:
+    SerialEmu &_serial;
+    volatile bool _exit;
+    pthread_mutex_t _mutex;
+
+    uint32_t _scale;
+    uint32_t _start_epoch;
+    unsigned long _start_ms;
+
+    typedef struct {
+        uint64_t msg_id;
+        uint16_t app_id;
+        uint32_t epoch;         // queued or received
+        uint32_t deadline;      // epoch when unsent message is dropped, 0 for default hold time
+        bool read;
+        char hex[TILE_MAX_MSG_SIZE * 2 + 1];
+    } _msg_t;
+    _msg_t _outbox[TILE_SIM_DB_SIZE];
+    uint16_t _outbox_count;
+    uint16_t _outbox_size;
+    _msg_t _inbox[TILE_SIM_DB_SIZE];
+    uint16_t _inbox_count;
+    _msg_t _injected[TILE_SIM_DB_SIZE];
+    uint16_t _injected_count;
+    uint64_t _next_id;
+
+    uint32_t _pass_interval;
+    uint32_t _pass_duration;
+    uint16_t _pass_capacity;
+    uint32_t _pass_start;       // epoch of current or next pass
+    uint16_t _pass_sent;        // messages sent in current pass
+    bool _in_pass;
+
+    uint32_t _rates[TILE_SIM_RATE_COUNT];
+    uint32_t _rate_next[TILE_SIM_RATE_COUNT];
+    uint8_t _gpio_mode;
+    uint32_t _sleep_until;      // 0 if awake
+    bool _powered;
+    uint32_t _boot_at;          // epoch when pending reboot completes, 0 if none
+    tile_sim_stats_t _stats;
+
+    void *_run();
+    void _tick();
+    void _command(char *line);
+    void _respond(const char *fmt, ...);
+    void _datetime(char *buf, size_t len, uint32_t epoch, bool iso);
+    void _periodic(uint8_t i);
+    void _boot();
+    bool _remove(_msg_t *db, uint16_t &count, uint16_t index);
+    void _commandTD(const char *args);
+    void _commandMT(const char *args);
+    void _commandMM(const char *args);
+    void _commandSL(const char *args);
+    void _commandRate(uint8_t i, const char *cmd, const char *args);
+    void _listMsg(const char *cmd, const _msg_t &msg);
+};
+
+#endif
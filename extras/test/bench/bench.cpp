@@ -0,0 +1,365 @@
+/*
+ * Benchmarks for the protocol hot paths of SwarmTile
+ *
+ * Run `make bench` in extras/test. Each benchmark repeats an operation until it ran for
+ * at least the minimum time and reports ns/op and serial bytes/op. With -j results are
+ * printed as JSON to compare runs between commits. Each operation is checked once before
+ * it is timed, a benchmark that fails exits with 1 instead of reporting a speed-up.
+ *
+ * bench [-j] [-t ms] [filter]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// built as one translation unit with the library to reach its file-local helpers
+#include "../../../src/SwarmTile.cpp"
+
+#include "SerialEmu.h"
+#include "TileSim.h"
+
+#define BENCH_MIN_TIME_MS 200
+#define BENCH_MAX_ITERATIONS 100000000UL
+
+static uint64_t bench_bytes;    // serial bytes moved by current benchmark
+static volatile uint64_t bench_sink;    // keeps results of timed operations alive
+
+// Tile that answers every command line at once with the same response, without threads
+class BenchStream : public Stream {
+public:
+    BenchStream() : _response(""), _len(0), _pos(0) {}
+
+    void setResponse(const char *response) {
+        _response = response;
+        _len = 0;
+        _pos = 0;
+    }
+
+    virtual int available() { return _len - _pos; }
+    virtual int read() {
+        if (_pos >= _len) {
+            return -1;
+        }
+        bench_bytes++;
+        return (uint8_t) _response[_pos++];
+    }
+    virtual int peek() { return _pos < _len ? (uint8_t) _response[_pos] : -1; }
+    virtual size_t write(uint8_t c) {
+        bench_bytes++;
+        if (c == '\n') {
+            _len = strlen(_response);
+            _pos = 0;
+        }
+        return 1;
+    }
+
+private:
+    const char *_response;
+    size_t _len;
+    size_t _pos;
+};
+
+// counts bytes going through another stream
+class CountingStream : public Stream {
+public:
+    CountingStream(Stream &stream) : _stream(stream) {}
+
+    virtual int available() { return _stream.available(); }
+    virtual int read() {
+        int c = _stream.read();
+        if (c >= 0) {
+            bench_bytes++;
+        }
+        return c;
+    }
+    virtual int peek() { return _stream.peek(); }
+    virtual size_t write(uint8_t c) {
+        bench_bytes++;
+        return _stream.write(c);
+    }
+
+private:
+    Stream &_stream;
+};
+
+typedef struct {
+    const char *name;
+    uint64_t iterations;
+    double ns_per_op;
+    double bytes_per_op;
+} bench_result_t;
+
+// returns true if the operation gave the expected result
+typedef bool (*bench_fn_t)(void *context);
+
+static uint64_t bench_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// run fn often enough to take at least min_ms
+static bench_result_t bench_run(const char *name, bench_fn_t fn, void *context, uint32_t min_ms)
+{
+    bench_result_t result;
+    uint64_t iterations = 1;
+    uint64_t elapsed;
+    uint64_t ok = 0;
+
+    while (1) {
+        bench_bytes = 0;
+        uint64_t start = bench_ns();
+        for (uint64_t i = 0; i < iterations; i++) {
+            ok += fn(context);
+        }
+        elapsed = bench_ns() - start;
+        if (elapsed >= min_ms * 1000000ULL || iterations >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+        // aim for the minimum time with some margin, grow at most 100x per round
+        uint64_t next = elapsed ? iterations * min_ms * 1200000ULL / elapsed : iterations * 100;
+        if (next > iterations * 100) {
+            next = iterations * 100;
+        }
+        iterations = next > iterations ? next : iterations + 1;
+    }
+
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = (double) elapsed / iterations;
+    result.bytes_per_op = (double) bench_bytes / iterations;
+    bench_sink = ok;
+    return result;
+}
+
+// append checksum and newline to NMEA sentence
+static const char *nmea(char *buf, size_t buf_len, const char *sentence)
+{
+    uint8_t cs = 0;
+    for (const char *c = sentence + 1; *c; c++) {
+        cs ^= (uint8_t) *c;
+    }
+    snprintf(buf, buf_len, "%s*%02x\n", sentence, cs);
+    return buf;
+}
+
+// operations on a Tile answering without delay
+
+typedef struct {
+    SwarmTile *tile;
+    char message[TILE_MAX_MSG_SIZE];
+    uint16_t len;
+} send_context_t;
+
+static bool bench_send(void *context)
+{
+    send_context_t *c = (send_context_t*) context;
+    return c->tile->sendMessage(c->message, c->len) == TILE_SUCCESS;
+}
+
+// readMessage on tile is expected to return len bytes
+typedef struct {
+    SwarmTile *tile;
+    uint16_t len;
+} read_context_t;
+
+static bool bench_read(void *context)
+{
+    read_context_t *c = (read_context_t*) context;
+    char buf[TILE_MAX_MSG_SIZE];
+    return c->tile->readMessage(buf, sizeof(buf)) == c->len;
+}
+
+static bool bench_command(void *context)
+{
+    tile_response_t response;
+    return ((SwarmTile*) context)->command("$MM R=O", response) == TILE_SUCCESS &&
+        response.field_count == 4;
+}
+
+static bool bench_datetime(void *context)
+{
+    tile_datetime_t datetime;
+    return ((SwarmTile*) context)->getDateTime(datetime) == TILE_SUCCESS && datetime.valid &&
+        datetime.second == 22;
+}
+
+// file-local helpers of the library, inputs are read through volatile variables so the
+// compiler can't compute results at build time
+
+static char max_line[TILE_RX_BUFFER_SIZE];
+static const char *volatile uint_input = "21990235111426";
+static volatile uint32_t epoch_input = 1623385462;
+static tile_datetime_t datetime_input;
+static tile_datetime_t *volatile datetime_ptr = &datetime_input;
+
+static bool bench_nmeaValidate(void *context)
+{
+    return _nmeaValidate(max_line, strlen(max_line) - 1);
+}
+
+static bool bench_strToUInt(void *context)
+{
+    return _strToUInt(uint_input, 14) == 21990235111426ULL;
+}
+
+static bool bench_makeEpoch(void *context)
+{
+    return _makeEpoch(*datetime_ptr) == 1623385462;
+}
+
+static bool bench_makeDatetime(void *context)
+{
+    tile_datetime_t datetime;
+    _makeDatetime(datetime, epoch_input);
+    return datetime.year == 2021 && datetime.second == 22;
+}
+
+// round trips through SerialEmu to the simulated Tile in another thread
+
+static bool bench_simVersion(void *context)
+{
+    tile_version_t version;
+    return ((SwarmTile*) context)->getVersion(version) == TILE_SUCCESS && version.valid;
+}
+
+static bool bench_simUnsent(void *context)
+{
+    tile_msg_count_t count;
+    return ((SwarmTile*) context)->getUnsentCount(count) == TILE_SUCCESS && count.valid;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: bench [-j] [-t ms] [filter]\n");
+    fprintf(stderr, "  -j       print results as JSON\n");
+    fprintf(stderr, "  -t ms    minimum run time per benchmark, default %d\n", BENCH_MIN_TIME_MS);
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    uint32_t min_ms = BENCH_MIN_TIME_MS;
+    const char *filter = 0;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jt:h")) != -1) {
+        switch (opt) {
+            case 'j': json = true; break;
+            case 't': min_ms = atoi(optarg); break;
+            default: usage(); return 2;
+        }
+    }
+    if (optind < argc) {
+        filter = argv[optind];
+    }
+
+    BenchStream stream;
+    SwarmTile tile(stream);
+    char response[TILE_RX_BUFFER_SIZE];
+    char sentence[TILE_RX_BUFFER_SIZE];
+
+    SerialEmu sim_serial;
+    TileSim sim(sim_serial);
+    CountingStream sim_stream(sim_serial);
+    SwarmTile sim_tile(sim_stream);
+    pthread_t sim_th;
+    sim.setPasses(0, 0, 0);
+    pthread_create(&sim_th, NULL, &TileSim::run, &sim);
+    sim_tile.begin();
+
+    send_context_t send1 = { &tile, "a", 1 };
+    send_context_t send64 = { &tile, "", 64 };
+    send_context_t send192 = { &tile, "", TILE_MAX_MSG_SIZE };
+    memset(send64.message, 'b', sizeof(send64.message));
+    memset(send192.message, 'c', sizeof(send192.message));
+
+    // $MM line with 15 and TILE_MAX_MSG_SIZE bytes message
+    char typical_mm[TILE_RX_BUFFER_SIZE];
+    char max_mm[TILE_RX_BUFFER_SIZE];
+    nmea(typical_mm, sizeof(typical_mm), "$MM AI=1234,6578616d706c65206d657373616765,21990235111426,1584494275");
+    strcpy(sentence, "$MM AI=65535,");
+    for (int i = 0; i < TILE_MAX_MSG_SIZE; i++) {
+        strcat(sentence, "ff");
+    }
+    strcat(sentence, ",21990235111426,1584494275");
+    nmea(max_mm, sizeof(max_mm), sentence);
+    strcpy(max_line, max_mm);
+    read_context_t read_typical = { &tile, 15 };
+    read_context_t read_max = { &tile, TILE_MAX_MSG_SIZE };
+    memset(&datetime_input, 0, sizeof(datetime_input));
+    datetime_input.year = 2021;
+    datetime_input.month = 6;
+    datetime_input.day = 11;
+    datetime_input.hour = 4;
+    datetime_input.minute = 24;
+    datetime_input.second = 22;
+    datetime_input.valid = true;
+
+    struct {
+        const char *name;
+        bench_fn_t fn;
+        void *context;
+        const char *response;
+    } benches[] = {
+        { "send_1", bench_send, &send1, 0 },
+        { "send_64", bench_send, &send64, 0 },
+        { "send_192", bench_send, &send192, 0 },
+        { "parse_mm_typical", bench_command, &tile, typical_mm },
+        { "parse_mm_max", bench_command, &tile, max_mm },
+        { "read_mm_typical", bench_read, &read_typical, typical_mm },
+        { "read_mm_max", bench_read, &read_max, max_mm },
+        { "parse_dt", bench_datetime, &tile, 0 },
+        { "nmea_validate_max", bench_nmeaValidate, 0, 0 },
+        { "str_to_uint", bench_strToUInt, 0, 0 },
+        { "make_epoch", bench_makeEpoch, 0, 0 },
+        { "make_datetime", bench_makeDatetime, 0, 0 },
+        { "emu_roundtrip_fv", bench_simVersion, &sim_tile, 0 },
+        { "emu_roundtrip_mt", bench_simUnsent, &sim_tile, 0 },
+    };
+    const int count = sizeof(benches) / sizeof(benches[0]);
+
+    if (json) {
+        printf("[\n");
+    }
+    bool first = true;
+    for (int i = 0; i < count; i++) {
+        if (filter && !strstr(benches[i].name, filter)) {
+            continue;
+        }
+        if (benches[i].fn == bench_send) {
+            stream.setResponse(nmea(response, sizeof(response), "$TD OK,5001"));
+        } else if (benches[i].fn == bench_datetime) {
+            stream.setResponse(nmea(response, sizeof(response), "$DT 20210611042422,V"));
+        } else if (benches[i].response) {
+            stream.setResponse(benches[i].response);
+        }
+
+        if (!benches[i].fn(benches[i].context)) {
+            fprintf(stderr, "bench: %s failed\n", benches[i].name);
+            ret = 1;
+            continue;
+        }
+        bench_result_t r = bench_run(benches[i].name, benches[i].fn, benches[i].context, min_ms);
+        if (json) {
+            printf("%s  {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"bytes_per_op\": %.1f}",
+                   first ? "" : ",\n", r.name, (unsigned long long) r.iterations, r.ns_per_op, r.bytes_per_op);
+        } else {
+            printf("%-20s %12llu %12.1f ns/op %8.1f B/op\n",
+                   r.name, (unsigned long long) r.iterations, r.ns_per_op, r.bytes_per_op);
+        }
+        first = false;
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+
+    sim.stop();
+    pthread_join(sim_th, NULL);
+    return ret;
+}
@@ -1,9 +1,23 @@
 #include <stdio.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
 #include "munit/munit.h"
 #include "SwarmTile.h"
 #include "SerialEmu.h"
 #include "TileEmu.h"
+#include "TileSim.h"
+#include "TileReplay.h"
+#include "TileRecovery.h"
+#include "HostFile.h"
+#include "HostSerial.h"
+#include "TileGateway.h"
+#include "TileCli.h"
+#include <sys/socket.h>
+#include <sys/un.h>
 
 // define get verbose output of NMEA traffic
 // #define VERBOSE
@@ -18,6 +32,8 @@ void print_result(tile_status_t);
 void tile_emu_begin(const char *expected, const char *response);
 void tile_emu_begin(emu_sequence_t *sequence);
 void tile_emu_end(tile_status_t result);
+const char *nmea(char *buf, size_t buf_len, const char *sentence);
+void emu_unsolicited(const char *sentence);
 
 static MunitResult test_nmeaParsing(const MunitParameter params[], void *data)
 {
@@ -48,6 +64,55 @@ static MunitResult test_nmeaParsing(const MunitParameter params[], void *data)
     return MUNIT_OK;
 }
 
+static MunitResult test_rxResync(const MunitParameter params[], void *data)
+{
+    tile_status_t result;
+    tile_msg_count_t count;
+    tile_rx_stats_t stats;
+    char resp[TILE_RX_BUFFER_SIZE * 2];
+    char line[50];
+
+    tile.resetRxStats();
+
+    // oversized line is discarded, response behind it is used
+    memset(resp, 0, sizeof(resp));
+    memset(resp, 'a', TILE_RX_BUFFER_SIZE + 10);
+    resp[0] = '$';
+    strcat(resp, "\n");
+    strcat(resp, nmea(line, sizeof(line), "$MT 12"));
+    tile_emu_begin("$MT C=U", resp);
+    result = tile.getUnsentCount(count);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 12);
+
+    // noise, corrupted response and partial line are skipped
+    snprintf(resp, sizeof(resp), "\x01\xff$MT 99*00\n$MT 1$MT 13*%s", nmea(line, sizeof(line), "$MT 13") + 7);
+    tile_emu_begin("$MT C=U", resp);
+    result = tile.getUnsentCount(count);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 13);
+
+    // command must match exactly
+    resp[0] = 0;
+    strcat(resp, nmea(line, sizeof(line), "$MTX 5"));
+    strcat(resp, nmea(line, sizeof(line), "$MT 14"));
+    tile_emu_begin("$MT C=U", resp);
+    result = tile.getUnsentCount(count);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 14);
+
+    tile.getRxStats(stats);
+    munit_assert_int(stats.overflows, ==, 1);
+    munit_assert_int(stats.corrupted, ==, 2);
+    munit_assert_int(stats.noise, ==, 2);
+    munit_assert_int(stats.lines, ==, 5);
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_getVersion(const MunitParameter params[], void* data)
 {
     tile_status_t result;
@@ -61,6 +126,9 @@ static MunitResult test_getVersion(const MunitParameter params[], void* data)
     munit_assert_true(version.valid);
     munit_assert_string_equal(version.date_str, "2021-03-23-18:25:40");
     munit_assert_string_equal(version.version_str, "v1.0.0");
+    munit_assert_int(version.major, ==, 1);
+    munit_assert_int(version.minor, ==, 0);
+    munit_assert_int(version.patch, ==, 0);
 
     // missing response fields
     tile_emu_begin("$FV", "$FV");
@@ -72,6 +140,65 @@ static MunitResult test_getVersion(const MunitParameter params[], void* data)
     return MUNIT_OK;
 }
 
+static MunitResult test_capabilities(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_version_t version;
+    tile_send_msg_t send;
+
+    // capabilities are derived from firmware version
+    tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(tile.hasCapability(TILE_CAP_APP_ID));
+    munit_assert_false(tile.hasCapability(TILE_CAP_DB_FIXED));
+
+    // app_id is rejected without asking Tile
+    memset(&send, 0, sizeof(send));
+    send.message = "a";
+    send.msg_len = 1;
+    send.app_id = 1000;
+    result = tile.sendMessage(send);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_BADAPPID);
+
+    // begin() forgets cached capabilities, queried once on next use
+    tile.begin();
+    tile_emu_begin("$FV", "$FV 2021-11-04-16:33:05,v1.1.12");
+    munit_assert_true(tile.hasCapability(TILE_CAP_APP_ID));
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_true(tile.hasCapability(TILE_CAP_DB_FIXED));
+
+    tile_emu_begin("$TD AI=1000,61", "$TD OK,4001");
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // parse version
+    tile_emu_begin("$FV", "$FV 2021-11-04-16:33:05,v1.1.12");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(version.major, ==, 1);
+    munit_assert_int(version.minor, ==, 1);
+    munit_assert_int(version.patch, ==, 12);
+
+    // capabilities stay unknown for a version string without number
+    tile.begin();
+    tile_emu_begin("$FV", "$FV 2022-01-10-09:12:44,dev");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(version.valid);
+    munit_assert_int(version.major, ==, 0);
+    tile_emu_begin("$TD AI=1000,61", "$TD OK,4002");
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_getConfig(const MunitParameter params[], void* data)
 {
     tile_status_t result;
@@ -97,6 +224,14 @@ static MunitResult test_getConfig(const MunitParameter params[], void* data)
     munit_assert_int(config.device_id, ==, 0x51b);
     munit_assert_string_equal(config.device_type, "TILE");
 
+    // fields in any order, device type truncated to buffer
+    tile_emu_begin("$CS", "$CS DN=TILE-WITH-A-LONG-NAME,DI=0x00051b");
+    result = tile.getConfig(config);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(config.device_id, ==, 0x51b);
+    munit_assert_string_equal(config.device_type, "TILE-WITH-A-LON");
+
     // missing response fields
     tile_emu_begin("$CS", "$CS");
     result = tile.getConfig(config);
@@ -132,6 +267,73 @@ static MunitResult test_setGpioMode(const MunitParameter params[], void* data)
     return MUNIT_OK;
 }
 
+static volatile int gpio_isr_count = 0;
+static void gpio_isr()
+{
+    gpio_isr_count++;
+}
+
+static MunitResult test_gpio(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_gpio_mode_t mode;
+
+    // set GPIO mode with typed value
+    tile_emu_begin("$GP 6", "$GP OK");
+    result = tile.setGpioMode(TILE_GPIO_MSG_PENDING_HIGH);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // query GPIO mode
+    tile_emu_begin("$GP ?", "$GP 6");
+    result = tile.getGpioMode(mode);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(mode, ==, TILE_GPIO_MSG_PENDING_HIGH);
+
+    // modes that don't signal events can't be attached
+    result = tile.attachGpioPin(3, TILE_GPIO_OUTPUT_HIGH);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_string_equal(tile.getErrorStr(), "BADGPIOMODE");
+    munit_assert_int(tile.getError(), ==, TILE_ERR_BADGPIOMODE);
+
+    // attach pin with interrupt, active high
+    emu_setPin(3, LOW);
+    gpio_isr_count = 0;
+    tile_emu_begin("$GP 6", "$GP OK");
+    result = tile.attachGpioPin(3, TILE_GPIO_MSG_PENDING_HIGH, gpio_isr);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(tile.isGpioActive());
+    munit_assert_false(tile.hasUnreadMessages());   // no serial traffic, emulator isn't running
+    emu_setPin(3, HIGH);
+    munit_assert_int(gpio_isr_count, ==, 1);
+    munit_assert_true(tile.isGpioActive());
+
+    // pin signals pending messages, library asks Tile for count
+    tile_emu_begin("$MM C=U", "$MM 2");
+    munit_assert_true(tile.hasUnreadMessages());
+    tile_emu_end(TILE_SUCCESS);
+
+    // attach pin without interrupt, active low
+    emu_setPin(4, HIGH);
+    tile_emu_begin("$GP 5", "$GP OK");
+    result = tile.attachGpioPin(4, TILE_GPIO_MSG_PENDING_LOW);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(tile.isGpioActive());
+    emu_setPin(3, LOW);
+    emu_setPin(3, HIGH);
+    munit_assert_int(gpio_isr_count, ==, 1);   // previous interrupt was detached
+    emu_setPin(4, LOW);
+    munit_assert_true(tile.isGpioActive());
+
+    tile.detachGpioPin();
+    munit_assert_false(tile.isGpioActive());
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_sleep(const MunitParameter params[], void* data)
 {
     tile_status_t result;
@@ -186,6 +388,7 @@ static MunitResult test_wake(const MunitParameter params[], void* data)
     result = tile.wake();
     tile_emu_end(result);
     munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_NOCOMMAND);
 
     return MUNIT_OK;
 }
@@ -205,6 +408,7 @@ static MunitResult test_powerOff(const MunitParameter params[], void* data)
     result = tile.powerOff();
     tile_emu_end(result);
     munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_UNKNOWN);
 
     return MUNIT_OK;
 }
@@ -282,6 +486,171 @@ static MunitResult test_getGeoData(const MunitParameter params[], void* data)
     return MUNIT_OK;
 }
 
+static MunitResult test_getStatusSnapshot(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_status_snapshot_t snapshot;
+
+    // all queries are written before responses are read
+    emu_sequence_t seq[] = {
+        { "$DT @", "$DT 20210611042422,V" },
+        { "$MT C=U", "$MT 12" },
+        { "$MM C=U", "$MM 2" },
+        { "$GS @", "$GS 109,214,9,0,G3" },
+        { "$GN @", "$GN 37.8921,-122.0155,77,89,2" },
+        { "$FV", "$FV 2021-11-04-16:33:05,v1.1.0" },
+        { 0, 0 }
+    };
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,999");
+    tile_emu_begin(seq);
+    result = tile.getStatusSnapshot(snapshot);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(snapshot.datetime.valid);
+    munit_assert_int(snapshot.datetime.year, ==, 2021);
+    munit_assert_int(snapshot.datetime.second, ==, 22);
+    munit_assert_true(snapshot.unsent.valid);
+    munit_assert_int(snapshot.unsent.count, ==, 12);
+    munit_assert_true(snapshot.unread.valid);
+    munit_assert_int(snapshot.unread.count, ==, 2);
+    munit_assert_true(snapshot.gps_fix);
+    munit_assert_true(snapshot.geo_data.valid);
+    munit_assert_float(snapshot.geo_data.latitude, ==, 37.8921);
+    munit_assert_float(snapshot.geo_data.speed, ==, 2.0);
+    munit_assert_true(snapshot.version.valid);
+    munit_assert_int(snapshot.version.minor, ==, 1);
+
+    // errors and missing fix only invalidate affected members
+    emu_sequence_t partial_seq[] = {
+        { "$DT @", "$DT 20210611042422,I" },
+        { "$MT C=U", "$MT ERR,BADPARAM" },
+        { "$MM C=U", "$MM 0" },
+        { "$GS @", "$GS 0,0,0,0,NF" },
+        { "$GN @", "$GN 0,0,0,0,0" },
+        { "$FV", "$FV 2021-11-04-16:33:05,v1.1.0" },
+        { 0, 0 }
+    };
+    tile_emu_begin(partial_seq);
+    result = tile.getStatusSnapshot(snapshot);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(snapshot.datetime.valid);
+    munit_assert_false(snapshot.unsent.valid);
+    munit_assert_true(snapshot.unread.valid);
+    munit_assert_int(snapshot.unread.count, ==, 0);
+    munit_assert_false(snapshot.gps_fix);
+    munit_assert_false(snapshot.geo_data.valid);
+    munit_assert_true(snapshot.version.valid);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_getPowerStatus(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_power_t power;
+    char response[200];
+    char line[100];
+
+    // get power status
+    tile_emu_begin("$PW @", "$PW 3.30100,0.00000,0.00000,0.00000,31.0");
+    result = tile.getPowerStatus(power);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(power.valid);
+    munit_assert_float(power.cpu_volts, ==, 3.301f);
+    munit_assert_float(power.temperature, ==, 31.0f);
+
+    // missing response fields
+    tile_emu_begin("$PW @", "$PW 3.30100");
+    result = tile.getPowerStatus(power);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_PROTOCOL_ERROR);
+    munit_assert_false(power.valid);
+
+    // enable periodic message, message arrives before response
+    nmea(response, sizeof(response), "$PW 3.20000,0.00000,0.00000,0.00000,30.0");
+    strcat(response, nmea(line, sizeof(line), "$PW OK"));
+    tile_emu_begin("$PW 60", response);
+    result = tile.setPowerStatusRate(60);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // latest periodic message is returned without asking Tile
+    emu_unsolicited("$PW 3.10000,0.00000,0.00000,0.00000,35.5");
+    result = tile.getPowerStatus(power);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(power.valid);
+    munit_assert_float(power.cpu_volts, ==, 3.1f);
+    munit_assert_float(power.temperature, ==, 35.5f);
+
+    // disable periodic message
+    tile_emu_begin("$PW 0", "$PW OK");
+    result = tile.setPowerStatusRate(0);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_getJammingStatus(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_jamming_t jamming;
+
+    // get jamming status
+    tile_emu_begin("$GJ @", "$GJ 2,87");
+    result = tile.getJammingStatus(jamming);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(jamming.valid);
+    munit_assert_int(jamming.spoof_state, ==, TILE_SPOOF_INDICATED);
+    munit_assert_int(jamming.jamming_level, ==, 87);
+
+    // missing response fields
+    tile_emu_begin("$GJ @", "$GJ");
+    result = tile.getJammingStatus(jamming);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_PROTOCOL_ERROR);
+    munit_assert_false(jamming.valid);
+
+    // enable periodic message
+    tile_emu_begin("$GJ 30", "$GJ OK");
+    result = tile.setJammingStatusRate(30);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // no periodic message received yet, ask Tile
+    tile_emu_begin("$GJ @", "$GJ 1,3");
+    result = tile.getJammingStatus(jamming);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(jamming.spoof_state, ==, TILE_SPOOF_NONE);
+    munit_assert_int(jamming.jamming_level, ==, 3);
+
+    // latest periodic message is returned without asking Tile
+    emu_unsolicited("$GJ 1,200");
+    result = tile.getJammingStatus(jamming);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(jamming.jamming_level, ==, 200);
+
+    // Tile stopped sending, e.g. after reboot, ask Tile again
+    emu_setVirtualClock(true);
+    emu_advanceClock(59000000);
+    result = tile.getJammingStatus(jamming);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(jamming.jamming_level, ==, 200);
+    emu_advanceClock(2000000);
+    tile_emu_begin("$GJ @", "$GJ 1,4");
+    result = tile.getJammingStatus(jamming);
+    tile_emu_end(result);
+    emu_setVirtualClock(false);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(jamming.jamming_level, ==, 4);
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_getUnsentCount(const MunitParameter params[], void* data)
 {
     tile_status_t result;
@@ -472,6 +841,30 @@ static MunitResult test_sendMessage(const MunitParameter params[], void* data)
     munit_assert_int(result, ==, TILE_COMMAND_ERROR);
     munit_assert_false(send.valid);
     munit_assert_string_equal(tile.getErrorStr(), "BADEXPIRETIME");
+    munit_assert_int(tile.getError(), ==, TILE_ERR_BADEXPIRETIME);
+
+    // outbound database full
+    tile_emu_begin("$TD 68656c6c6f20776f726c64", "$TD ERR,DBXTOHIVEFULL,0");
+    result = tile.sendMessage(test_msg);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_DBXTOHIVEFULL);
+
+    // error not known to library
+    tile_emu_begin("$TD 68656c6c6f20776f726c64", "$TD ERR,SOMETHINGNEW,0");
+    result = tile.sendMessage(test_msg);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_UNKNOWN);
+    munit_assert_string_equal(tile.getErrorStr(), "SOMETHINGNEW");
+
+    // success clears error
+    tile_emu_begin("$TD 68656c6c6f20776f726c64", "$TD OK,5354468575855");
+    result = tile.sendMessage(test_msg);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_NONE);
+    munit_assert_string_equal(tile.getErrorStr(), "");
 
     return MUNIT_OK;
 }
@@ -597,26 +990,1575 @@ static MunitResult test_readMessage(const MunitParameter params[], void* data)
     munit_assert_int(result, ==, TILE_COMMAND_ERROR);
     munit_assert_false(read.valid);
     munit_assert_string_equal(tile.getErrorStr(), "DBXNOMORE");
+    munit_assert_int(tile.getError(), ==, TILE_ERR_DBXNOMORE);
+
+    // longest message with app ID and 20 digit msg_id fits into rx buffer
+    char max_line[TILE_RX_BUFFER_SIZE];
+    strcpy(max_line, "$MM AI=64999,");
+    for (int i = 0; i < TILE_MAX_MSG_SIZE; i++) {
+        strcat(max_line, "6d");
+    }
+    strcat(max_line, ",18446744073709551615,1584494275");
+    memset(&read, 0, sizeof(read));
+    read.message = msg_buf;
+    read.msg_max = msg_buf_len;
+    read.order = TILE_OLDEST;
+    tile_emu_begin("$MM R=O", max_line);
+    result = tile.readMessage(read);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(read.msg_len, ==, TILE_MAX_MSG_SIZE);
+    munit_assert_int(read.app_id, ==, 64999);
+    munit_assert(read.msg_id == 18446744073709551615ULL);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_command(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_response_t resp;
+
+    // fields are returned as views into receive buffer
+    tile_emu_begin("$CS", "$CS DI=0x000e57,DN=TILE");
+    result = tile.command("$CS", resp);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(resp.valid);
+    munit_assert_int(resp.field_count, ==, 2);
+    munit_assert_int(resp.fields[0].len, ==, 3);
+    munit_assert_memory_equal(3, resp.fields[0].ptr, "$CS");
+    munit_assert_int(resp.fields[1].len, ==, 11);
+    munit_assert_memory_equal(11, resp.fields[1].ptr, "DI=0x000e57");
+    munit_assert_int(resp.fields[2].len, ==, 7);
+    munit_assert_memory_equal(7, resp.fields[2].ptr, "DN=TILE");
+
+    // periodic messages don't answer command
+    emu_unsolicited("$RT RSSI=-104");
+    tile_emu_begin("$RT @", "$RT 0");
+    result = tile.command("$RT @", resp);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(resp.field_count, ==, 1);
+    munit_assert_memory_equal(1, resp.fields[1].ptr, "0");
+
+    // error responses are returned too
+    tile_emu_begin("$XX", "$XX ERR,NOCOMMAND");
+    result = tile.command("$XX", resp);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_NOCOMMAND);
+    munit_assert_true(resp.valid);
+    munit_assert_int(resp.field_count, ==, 2);
+    munit_assert_memory_equal(3, resp.fields[1].ptr, "ERR");
+
+    // fields beyond TILE_NMEA_FIELD_COUNT are ignored
+    tile_emu_begin("$XX", "$XX 1,2,3,4,5,6,7,8,9,10");
+    result = tile.command("$XX", resp);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(resp.field_count, ==, TILE_NMEA_FIELD_COUNT - 1);
+    munit_assert_memory_equal(1, resp.fields[TILE_NMEA_FIELD_COUNT - 1].ptr, "7");
+
+    // not a command
+    result = tile.command("CS", resp);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_BADPARAM);
+    munit_assert_false(resp.valid);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_receiveTest(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_rssi_stats_t stats;
+    tile_sat_pass_t passes[4];
+    char response[200];
+    char line[100];
+
+    tile.resetReceiveTestStats();
+    tile.getRssiStats(stats);
+    munit_assert_false(stats.valid);
+
+    // enable receive test, background sample arrives before response
+    nmea(response, sizeof(response), "$RT RSSI=-101");
+    strcat(response, nmea(line, sizeof(line), "$RT OK"));
+    tile_emu_begin("$RT 5", response);
+    result = tile.setReceiveTestRate(5);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    tile.getRssiStats(stats);
+    munit_assert_true(stats.valid);
+    munit_assert_int(stats.samples, ==, 1);
+    munit_assert_int(stats.last, ==, -101);
+
+    // process background samples and satellite packets with poll()
+    emu_unsolicited("$RT RSSI=-105");
+    emu_unsolicited("$RT RSSI=-97");
+    emu_unsolicited("$RT RSSI=-93,SNR=-6,FDEV=-435,TS=2021-06-04 22:43:11,DI=0x0009a1");
+    emu_unsolicited("$RT RSSI=-89,SNR=2,FDEV=-410,TS=2021-06-04 22:45:30,DI=0x0009a1");
+    emu_unsolicited("$RT RSSI=-95,SNR=-3,FDEV=120,TS=2021-06-04 23:50:00,DI=0x0009a1");
+    emu_unsolicited("$RT RSSI=-99,SNR=-9,FDEV=55,TS=2021-06-04 23:51:00,DI=0x000a22");
+    emu_unsolicited("$RT RSSI=-150*00");   // corrupted, ignored
+    result = tile.poll();
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    tile.getRssiStats(stats);
+    munit_assert_true(stats.valid);
+    munit_assert_int(stats.samples, ==, 3);
+    munit_assert_int(stats.total, ==, 3);
+    munit_assert_int(stats.last, ==, -97);
+    munit_assert_int(stats.min, ==, -105);
+    munit_assert_int(stats.max, ==, -97);
+    munit_assert_int(stats.mean, ==, -101);
+
+    munit_assert_int(tile.getSatPasses(passes, 4), ==, 3);
+    munit_assert_int(passes[0].sat_id, ==, 0xa22);
+    munit_assert_int(passes[0].packets, ==, 1);
+    munit_assert_int(passes[1].sat_id, ==, 0x9a1);
+    munit_assert_int(passes[1].packets, ==, 1);
+    munit_assert_int(passes[1].start.hour, ==, 23);
+    munit_assert_int(passes[2].sat_id, ==, 0x9a1);
+    munit_assert_int(passes[2].packets, ==, 2);
+    munit_assert_int(passes[2].rssi_max, ==, -89);
+    munit_assert_int(passes[2].snr_max, ==, 2);
+    munit_assert_int(passes[2].fdev, ==, -410);
+    munit_assert_int(passes[2].start.minute, ==, 43);
+    munit_assert_int(passes[2].end.minute, ==, 45);
+    munit_assert_int(passes[2].end.second, ==, 30);
+
+    // window is bounded
+    for (int i = 0; i < TILE_RSSI_WINDOW + 5; i++) {
+        emu_unsolicited("$RT RSSI=-110");
+    }
+    tile.poll();
+    tile.getRssiStats(stats);
+    munit_assert_int(stats.samples, ==, TILE_RSSI_WINDOW);
+    munit_assert_int(stats.total, ==, TILE_RSSI_WINDOW + 8);
+    munit_assert_int(stats.mean, ==, -110);
+
+    // disable receive test
+    tile_emu_begin("$RT 0", "$RT OK");
+    result = tile.setReceiveTestRate(0);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    tile.resetReceiveTestStats();
+    tile.getRssiStats(stats);
+    munit_assert_false(stats.valid);
+    munit_assert_int(tile.getSatPasses(passes, 4), ==, 0);
+
+    return MUNIT_OK;
+}
+
+// copies first field of unsolicited message into context
+static void copy_first_field(void *context, const tile_response_t &response)
+{
+    char *field = (char*) context;
+    memcpy(field, response.fields[1].ptr, response.fields[1].len);
+    field[response.fields[1].len] = 0;
+}
+
+static MunitResult test_linkStats(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_link_stats_t stats;
+    tile_sent_record_t records[4];
+    char response[200];
+    char line[100];
+
+    tile.resetLinkStats();
+    tile.getLinkStats(stats);
+    munit_assert_false(stats.valid);
+
+    // queue two messages, confirmation for an untracked message arrives before response
+    tile_emu_begin("$TD 68656c6c6f", "$TD OK,1001");
+    result = tile.sendMessage("hello");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    nmea(response, sizeof(response), "$TD SENT RSSI=-110,SNR=-2,FDEV=300,999");
+    strcat(response, nmea(line, sizeof(line), "$TD OK,1002"));
+    tile_emu_begin("$TD 776f726c64", response);
+    result = tile.sendMessage("world");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    tile.getLinkStats(stats);
+    munit_assert_true(stats.valid);
+    munit_assert_int(stats.sent, ==, 1);
+    munit_assert_int(stats.tracked, ==, 0);
+
+    // confirmations for queued messages, hook sees fields as received
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,1002");
+    emu_unsolicited("$TD SENT RSSI=-100,SNR=3,FDEV=50,1001");
+    emu_unsolicited("$TD SENT RSSI=-80,SNR=9,FDEV=50*00");     // corrupted, ignored
+    tile.setUnsolicitedHook(copy_first_field, line);
+    tile.poll();
+    tile.setUnsolicitedHook(0);
+    munit_assert_string_equal(line, "SENT RSSI=-100");
+
+    tile.getLinkStats(stats);
+    munit_assert_true(stats.valid);
+    munit_assert_int(stats.sent, ==, 3);
+    munit_assert_int(stats.tracked, ==, 2);
+    munit_assert_int(stats.latency_hist[0], ==, 2);
+    munit_assert_int(stats.latency_max, <, 60);
+    munit_assert_int(stats.rssi_min, ==, -110);
+    munit_assert_int(stats.rssi_max, ==, -90);
+    munit_assert_int(stats.rssi_mean, ==, -100);
+    munit_assert_int(stats.snr_min, ==, -2);
+    munit_assert_int(stats.snr_max, ==, 8);
+    munit_assert_int(stats.snr_mean, ==, 3);
+
+    munit_assert_int(tile.getSentLog(records, 4), ==, 3);
+    munit_assert(records[0].msg_id == 1001);
+    munit_assert_int(records[0].rssi, ==, -100);
+    munit_assert_int(records[0].fdev, ==, 50);
+    munit_assert_int(records[0].latency, !=, TILE_LATENCY_UNKNOWN);
+    munit_assert(records[1].msg_id == 1002);
+    munit_assert(records[2].msg_id == 999);
+    munit_assert_int(records[2].latency, ==, TILE_LATENCY_UNKNOWN);
+
+    tile.resetLinkStats();
+    tile.getLinkStats(stats);
+    munit_assert_false(stats.valid);
+    munit_assert_int(tile.getSentLog(records, 4), ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_queue(const MunitParameter params[], void* data)
+{
+    uint8_t buffer[100];
+    TileRamStorage storage(buffer, sizeof(buffer));
+    tile_send_msg_t msg;
+    tile_queue_stats_t stats;
+    char msg_buf[TILE_MAX_MSG_SIZE];
+    const char *payload[] = { "message 1...........", "message 2...........", "message 3..........." };
+
+    // drop oldest message when full
+    TileQueue oldest(storage, TILE_DROP_OLDEST);
+    memset(&msg, 0, sizeof(msg));
+    for (int i = 0; i < 3; i++) {
+        msg.message = payload[i];
+        msg.msg_len = strlen(payload[i]);
+        munit_assert_true(oldest.push(msg));
+    }
+    oldest.getStats(stats);
+    munit_assert_int(stats.count, ==, 2);
+    munit_assert_int(stats.queued, ==, 3);
+    munit_assert_int(stats.dropped, ==, 1);
+    munit_assert_int(stats.size, ==, sizeof(buffer));
+    munit_assert_true(oldest.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, payload[1]);
+    oldest.pop();
+    munit_assert_true(oldest.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, payload[2]);
+    oldest.discard();
+    munit_assert_false(oldest.peek(msg, msg_buf, sizeof(msg_buf)));
+    oldest.getStats(stats);
+    munit_assert_int(stats.count, ==, 0);
+    munit_assert_int(stats.used, ==, 0);
+    munit_assert_int(stats.submitted, ==, 1);
+    munit_assert_int(stats.dropped, ==, 2);
+
+    // reject new message when full
+    TileQueue newest(storage, TILE_DROP_NEWEST);
+    memset(&msg, 0, sizeof(msg));
+    for (int i = 0; i < 3; i++) {
+        msg.message = payload[i];
+        msg.msg_len = strlen(payload[i]);
+        munit_assert_true(newest.push(msg) == (i < 2));
+    }
+    newest.getStats(stats);
+    munit_assert_int(stats.count, ==, 2);
+    munit_assert_int(stats.rejected, ==, 1);
+    munit_assert_true(newest.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, payload[0]);
+
+    // drop least important message
+    TileQueue priority(storage, TILE_DROP_PRIORITY);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_len = strlen(payload[0]);
+    msg.message = payload[0];
+    msg.priority = 5;
+    munit_assert_true(priority.push(msg));
+    msg.message = payload[1];
+    msg.priority = 1;
+    munit_assert_true(priority.push(msg));
+    msg.message = payload[2];
+    msg.priority = 0;
+    munit_assert_false(priority.push(msg));     // lowest priority is rejected
+    msg.priority = 3;
+    munit_assert_true(priority.push(msg));      // replaces message with priority 1
+    priority.getStats(stats);
+    munit_assert_int(stats.count, ==, 2);
+    munit_assert_int(stats.dropped, ==, 1);
+    munit_assert_int(stats.rejected, ==, 1);
+    munit_assert_true(priority.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, payload[0]);
+    munit_assert_int(msg.priority, ==, 5);
+    priority.pop();
+    munit_assert_true(priority.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, payload[2]);
+    munit_assert_int(msg.priority, ==, 3);
+
+    // same priority, earliest deadline first, messages without hold time last
+    TileQueue deadline(storage);
+    const char *short_payload[] = { "x", "y", "z" };
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_len = 1;
+    msg.message = short_payload[0];
+    munit_assert_true(deadline.push(msg));
+    msg.message = short_payload[1];
+    msg.hold_time = 3600;
+    munit_assert_true(deadline.push(msg));
+    msg.message = short_payload[2];
+    msg.hold_time = 600;
+    munit_assert_true(deadline.push(msg));
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[2]);
+    munit_assert_int(msg.hold_time, ==, 600);
+    deadline.pop();
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[1]);
+    deadline.pop();
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[0]);
+    munit_assert_int(msg.hold_time, ==, 0);
+
+    // expiration time counts as deadline once current time is known
+    deadline.clear();
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_len = 1;
+    msg.message = short_payload[0];
+    msg.expiration.year = 2021;
+    msg.expiration.month = 6;
+    msg.expiration.day = 11;
+    msg.expiration.hour = 4;
+    msg.expiration.minute = 29;
+    msg.expiration.second = 22;
+    msg.expiration.valid = true;
+    munit_assert_int(SwarmTile::makeEpoch(msg.expiration), ==, 1623385762);
+    munit_assert_true(deadline.push(msg));
+    memset(&msg.expiration, 0, sizeof(msg.expiration));
+    msg.message = short_payload[1];
+    msg.hold_time = 600;
+    munit_assert_true(deadline.push(msg));
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[1]);
+    deadline.setTime(1623385462);
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[0]);
+    munit_assert_true(msg.expiration.valid);
+    munit_assert_int(msg.expiration.minute, ==, 29);
+    emu_setVirtualClock(true);
+    emu_advanceClock(301000000);
+    deadline.resetStats();
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_memory_equal(msg.msg_len, msg.message, short_payload[1]);
+    emu_setVirtualClock(false);
+    deadline.getStats(stats);
+    munit_assert_int(stats.dropped, ==, 1);
+    munit_assert_int(stats.count, ==, 1);
+
+    // remaining hold time below Tile's minimum, dropped instead of held longer
+    deadline.clear();
+    deadline.resetStats();
+    msg.message = short_payload[2];
+    msg.hold_time = 120;
+    munit_assert_true(deadline.push(msg));
+    emu_setVirtualClock(true);
+    emu_advanceClock(59000000);
+    munit_assert_true(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    munit_assert_int(msg.hold_time, ==, 61);
+    emu_advanceClock(2000000);
+    munit_assert_false(deadline.peek(msg, msg_buf, sizeof(msg_buf)));
+    emu_setVirtualClock(false);
+    deadline.getStats(stats);
+    munit_assert_int(stats.dropped, ==, 1);
+    munit_assert_int(stats.count, ==, 0);
+
+    // message larger than storage is rejected
+    priority.clear();
+    munit_assert_int(priority.count(), ==, 0);
+    msg.message = msg_buf;
+    msg.msg_len = sizeof(buffer);
+    munit_assert_false(priority.push(msg));
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_overflowQueue(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    uint8_t buffer[500];
+    TileRamStorage storage(buffer, sizeof(buffer));
+    TileQueue queue(storage);
+    tile_queue_stats_t stats;
+    tile_send_msg_t send;
+
+    tile.setOverflowQueue(&queue);
+
+    // Tile is full, message is queued locally
+    memset(&send, 0, sizeof(send));
+    send.message = "hello";
+    send.msg_len = 5;
+    tile_emu_begin("$TD 68656c6c6f", "$TD ERR,DBXTOHIVEFULL,0");
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(send.queued);
+    munit_assert_false(send.valid);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_NONE);
+
+    // following messages are queued without asking Tile
+    result = tile.sendMessage("world");
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(queue.count(), ==, 2);
+
+    // nothing is handed to Tile until it sent a message
+    tile.poll();
+    munit_assert_int(queue.count(), ==, 2);
+
+    // Tile sent a message, queue is drained until Tile is full again
+    emu_sequence_t drain_seq[] = {
+        { "$TD 68656c6c6f", "$TD OK,1001" },
+        { "$TD 776f726c64", "$TD ERR,DBXTOHIVEFULL,0" },
+        { 0, 0 }
+    };
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,999");
+    tile_emu_begin(drain_seq);
+    result = tile.poll();
+    tile_emu_end(result);
+    munit_assert_int(queue.count(), ==, 1);
+
+    emu_sequence_t drain_seq2[] = {
+        { "$TD 776f726c64", "$TD OK,1002" },
+        { "$TD 2121", "$TD OK,1003" },
+        { 0, 0 }
+    };
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,1001");
+    memset(&send, 0, sizeof(send));
+    send.message = "!!";
+    send.msg_len = 2;
+    tile_emu_begin(drain_seq2);
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(send.queued);
+    munit_assert_true(send.valid);
+    munit_assert_int(queue.count(), ==, 0);
+
+    queue.getStats(stats);
+    munit_assert_int(stats.queued, ==, 2);
+    munit_assert_int(stats.submitted, ==, 2);
+    munit_assert_int(stats.dropped, ==, 0);
+
+    // queue is full
+    TileRamStorage small_storage(buffer, 20);
+    TileQueue full(small_storage, TILE_DROP_NEWEST);
+    tile.setOverflowQueue(&full);
+    memset(&send, 0, sizeof(send));
+    send.message = "full";
+    send.msg_len = 4;
+    tile_emu_begin("$TD 66756c6c", "$TD ERR,DBXTOHIVEFULL,0");
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_QUEUEFULL);
+    munit_assert_false(send.queued);
+
+    tile.setOverflowQueue(0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sendWindow(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    uint8_t buffer[500];
+    TileRamStorage storage(buffer, sizeof(buffer));
+    TileQueue queue(storage);
+    tile_send_msg_t send;
+
+    tile.setOverflowQueue(&queue);
+    tile.setSendWindow(1);
+
+    // window has room, message is handed to Tile
+    memset(&send, 0, sizeof(send));
+    send.message = "a";
+    send.msg_len = 1;
+    send.priority = TILE_PRIORITY_BULK;
+    tile_emu_begin("$TD 61", "$TD OK,2001");
+    result = tile.sendMessage(send);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_false(send.queued);
+    munit_assert_true(send.valid);
+
+    // window is full, messages wait locally
+    send.message = "b";
+    result = tile.sendMessage(send);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(send.queued);
+    send.message = "c";
+    send.priority = TILE_PRIORITY_ALARM;
+    result = tile.sendMessage(send);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(send.queued);
+    munit_assert_int(queue.count(), ==, 2);
+
+    // alarm overtakes bulk message once Tile sent first message
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,2001");
+    tile_emu_begin("$TD 63", "$TD OK,2002");
+    result = tile.poll();
+    tile_emu_end(result);
+    munit_assert_int(queue.count(), ==, 1);
+
+    emu_unsolicited("$TD SENT RSSI=-90,SNR=8,FDEV=-100,2002");
+    tile_emu_begin("$TD 62", "$TD OK,2003");
+    result = tile.poll();
+    tile_emu_end(result);
+    munit_assert_int(queue.count(), ==, 0);
+
+    tile.setSendWindow(0);
+    tile.setOverflowQueue(0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_dbRecovery(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    char boot[300];
+    char line[100];
+
+    // Tile confirms dbinit and reboots
+    boot[0] = 0;
+    strcat(boot, nmea(line, sizeof(line), "$RS OK"));
+    strcat(boot, nmea(line, sizeof(line), "$M138 BOOT,RESTART"));
+    strcat(boot, nmea(line, sizeof(line), "$M138 BOOT,POWERON,LPWR=n,WDOG=n,BROWN=n,PIN=y,SW=y"));
+    strcat(boot, nmea(line, sizeof(line), "$M138 BOOT,RUNNING"));
+
+    tile.setDbRecovery(2);
+
+    // first error is reported as is
+    tile_emu_begin("$TD 61", "$TD ERR,DBXTOHIVEFULL,0");
+    result = tile.sendMessage("a");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_DBXTOHIVEFULL);
+
+    // affected firmware, database is reinitialized and message is sent again
+    emu_sequence_t recover_seq[] = {
+        { "$TD 61", "$TD ERR,DBXTOHIVEFULL,0" },
+        { "$FV", "$FV 2021-03-23-18:25:40,v1.0.0" },
+        { "$RS dbinit", boot },
+        { "$TD 61", "$TD OK,3001" },
+        { 0, 0 }
+    };
+    tile_emu_begin(recover_seq);
+    result = tile.sendMessage("a");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_NONE);
+    munit_assert_int(tile.getDbRecoveryCount(), ==, 1);
+
+    // fixed firmware, database is really full
+    tile.begin();
+    tile.setDbRecovery(1);
+    emu_sequence_t full_seq[] = {
+        { "$TD 61", "$TD ERR,DBXTOHIVEFULL,0" },
+        { "$FV", "$FV 2021-11-04-16:33:05,v1.1.0" },
+        { 0, 0 }
+    };
+    tile_emu_begin(full_seq);
+    result = tile.sendMessage("a");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+    munit_assert_int(tile.getError(), ==, TILE_ERR_DBXTOHIVEFULL);
+    munit_assert_int(tile.getDbRecoveryCount(), ==, 1);
+
+    // no further attempt until Tile accepted a message
+    tile_emu_begin("$TD 61", "$TD ERR,DBXTOHIVEFULL,0");
+    result = tile.sendMessage("a");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_COMMAND_ERROR);
+
+    tile.setDbRecovery(0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_sendRetry(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_send_msg_t msg;
+    char list[300];
+    char line[100];
+
+    tile.setSendRetry(2, 1);
+
+    // response got lost, Tile already holds message and it isn't sent again
+    char before[200];
+    before[0] = 0;
+    strcat(before, nmea(line, sizeof(line), "$MT 6262,4000,1700000000"));
+    strcat(before, nmea(line, sizeof(line), "$MT AI=7,61,4001,1700000000"));
+    strcat(before, nmea(line, sizeof(line), "$MT 2"));
+    list[0] = 0;
+    strcat(list, nmea(line, sizeof(line), "$MT 6262,4000,1700000000"));
+    strcat(list, nmea(line, sizeof(line), "$MT AI=7,61,4001,1700000000"));
+    strcat(list, nmea(line, sizeof(line), "$MT 61,5001,1700000000"));
+    strcat(list, nmea(line, sizeof(line), "$MT 3"));
+    emu_sequence_t found_seq[] = {
+        { "$MT L=U", before },
+        { "$TD 61", "$TD OK,5001*00\n" },
+        { "$MT L=U", list },
+        { 0, 0 }
+    };
+    memset(&msg, 0, sizeof(msg));
+    msg.message = "a";
+    msg.msg_len = 1;
+    tile_emu_begin(found_seq);
+    result = tile.sendMessage(msg);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_true(msg.valid);
+    munit_assert_int(msg.msg_id, ==, 5001);
+
+    // Tile doesn't hold message, it is sent again
+    emu_sequence_t resend_seq[] = {
+        { "$MT L=U", "$MT 0" },
+        { "$TD 62", "$TD OK,5002*00\n" },
+        { "$MT L=U", "$MT 0" },
+        { "$TD 62", "$TD OK,5002" },
+        { 0, 0 }
+    };
+    tile_emu_begin(resend_seq);
+    result = tile.sendMessage("b");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // identical message held before first attempt doesn't count as landed
+    list[0] = 0;
+    strcat(list, nmea(line, sizeof(line), "$MT 63,5003,1700000000"));
+    strcat(list, nmea(line, sizeof(line), "$MT 1"));
+    emu_sequence_t dup_seq[] = {
+        { "$MT L=U", list },
+        { "$TD 63", "$TD OK,5004*00\n" },
+        { "$MT L=U", list },
+        { "$TD 63", "$TD OK,5004" },
+        { 0, 0 }
+    };
+    memset(&msg, 0, sizeof(msg));
+    msg.message = "c";
+    msg.msg_len = 1;
+    tile_emu_begin(dup_seq);
+    result = tile.sendMessage(msg);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(msg.msg_id, ==, 5004);
+
+    // too many identical messages to tell apart, no retry
+    list[0] = 0;
+    for (int i = 0; i <= TILE_SEND_KNOWN_COUNT; i++) {
+        char sentence[40];
+        snprintf(sentence, sizeof(sentence), "$MT 63,%d,1700000000", 6000 + i);
+        strcat(list, nmea(line, sizeof(line), sentence));
+    }
+    strcat(list, nmea(line, sizeof(line), "$MT 5"));
+    emu_sequence_t many_seq[] = {
+        { "$MT L=U", list },
+        { "$TD 63", "$TD OK,5005*00\n" },
+        { 0, 0 }
+    };
+    tile_emu_begin(many_seq);
+    result = tile.sendMessage("c");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_PROTOCOL_ERROR);
+
+    // unsent messages can't be listed, message isn't sent blindly
+    tile.setSendRetry(1, 1);
+    emu_sequence_t unknown_seq[] = {
+        { "$MT L=U", "$MT 0" },
+        { "$TD 64", "$TD OK,5005*00\n" },
+        { "$MT L=U", "$MT 0*00\n" },
+        { 0, 0 }
+    };
+    tile_emu_begin(unknown_seq);
+    result = tile.sendMessage("d");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_PROTOCOL_ERROR);
+
+    tile.setSendRetry(0);
+
+    return MUNIT_OK;
+}
+
+// answers one command on the master side of a pty after a delay
+static int pty_master;
+static char pty_command[100];
+
+static void *pty_respond(void *arg)
+{
+    const char *response = (const char*) arg;
+    size_t pos = 0;
+    struct pollfd pfd = { pty_master, POLLIN, 0 };
+
+    while (pos < sizeof(pty_command) - 1 && poll(&pfd, 1, 1000) > 0) {
+        if (read(pty_master, pty_command + pos, 1) != 1 || pty_command[pos] == '\n') {
+            break;
+        }
+        pos++;
+    }
+    pty_command[pos] = 0;
+
+    // make library wait for response
+    usleep(50000);
+    if (write(pty_master, response, strlen(response)) < 0) {
+        return 0;
+    }
+    return 0;
+}
+
+static MunitResult test_hostSerial(const MunitParameter params[], void* data)
+{
+    HostSerial port;
+    SwarmTile host_tile(port);
+    tile_version_t version;
+    tile_status_t result;
+    pthread_t responder;
+    char line[100];
+
+    pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+    munit_assert_int(pty_master, >=, 0);
+    munit_assert_int(grantpt(pty_master), ==, 0);
+    munit_assert_int(unlockpt(pty_master), ==, 0);
+    munit_assert_true(port.begin(ptsname(pty_master), 115200));
+
+    host_tile.setTimeout(200);
+    host_tile.setWaitHook(HostSerial::waitHook, &port);
+    host_tile.begin();
+
+    // command and response pass through tty
+    nmea(line, sizeof(line), "$FV 2021-11-04-16:33:05,v1.1.0");
+    pthread_create(&responder, NULL, pty_respond, line);
+    result = host_tile.getVersion(version);
+    pthread_join(responder, NULL);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_string_equal(pty_command, "$FV*10");
+    munit_assert_string_equal(version.version_str, "v1.1.0");
+
+    // waiting for a response that never comes sleeps in poll()
+    clock_t cpu = clock();
+    result = host_tile.getVersion(version);
+    cpu = clock() - cpu;
+    munit_assert_int(result, ==, TILE_TIMEOUT);
+    munit_assert_int(cpu, <, CLOCKS_PER_SEC / 20);
+
+    port.end();
+    close(pty_master);
+
+    return MUNIT_OK;
+}
+
+static int gw_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void gw_request(int fd, uint8_t type, const void *payload, uint16_t len)
+{
+    uint8_t frame[TILE_GW_HEADER_SIZE + TILE_GW_MAX_PAYLOAD];
+    frame[0] = type;
+    frame[1] = len;
+    frame[2] = len >> 8;
+    memcpy(frame + TILE_GW_HEADER_SIZE, payload, len);
+    munit_assert_int(write(fd, frame, TILE_GW_HEADER_SIZE + len), ==, TILE_GW_HEADER_SIZE + len);
+}
+
+// returns payload length of next frame, -1 if none arrives
+static int gw_receive(int fd, uint8_t &type, uint8_t *payload)
+{
+    uint8_t hdr[TILE_GW_HEADER_SIZE];
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 50) <= 0 || recv(fd, hdr, sizeof(hdr), MSG_WAITALL) != sizeof(hdr)) {
+        return -1;
+    }
+    type = hdr[0];
+    uint16_t len = hdr[1] | (hdr[2] << 8);
+    if (len > 0 && recv(fd, payload, len, MSG_WAITALL) != len) {
+        return -1;
+    }
+    return len;
+}
+
+static MunitResult test_gateway(const MunitParameter params[], void* data)
+{
+    TileGateway gw(tile);
+    uint8_t payload[TILE_GW_MAX_PAYLOAD];
+    uint8_t type;
+    uint64_t msg_id;
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/tilelib-test-%d.sock", (int) getpid());
+    gw.setInboxInterval(0);
+    munit_assert_true(gw.begin(path));
+
+    int subscriber = gw_connect(path);
+    int client = gw_connect(path);
+    munit_assert_int(subscriber, >=, 0);
+    munit_assert_int(client, >=, 0);
+    gw.process(10);
+
+    uint8_t events = TILE_GW_SUB_SENT | TILE_GW_SUB_INBOX;
+    gw_request(subscriber, TILE_GW_SUBSCRIBE, &events, 1);
+    gw.process(10);
+    munit_assert_int(gw_receive(subscriber, type, payload), ==, 2);
+    munit_assert_int(type, ==, TILE_GW_SUBSCRIBE | TILE_GW_RESPONSE);
+    munit_assert_int(payload[0], ==, TILE_SUCCESS);
+
+    // send: app_id, hold_time, priority, message
+    uint8_t send_req[] = { 0, 0, 0, 0, 0, 0, 0, 'h', 'i' };
+    gw_request(client, TILE_GW_SEND, send_req, sizeof(send_req));
+    tile_emu_begin("$TD 6869", "$TD OK,6001");
+    gw.process(10);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(gw_receive(client, type, payload), ==, 11);
+    munit_assert_int(type, ==, TILE_GW_SEND | TILE_GW_RESPONSE);
+    munit_assert_int(payload[0], ==, TILE_SUCCESS);
+    memcpy(&msg_id, payload + 2, 8);
+    munit_assert_uint64(msg_id, ==, 6001);
+
+    // Tile errors are passed through
+    tile_emu_begin("$TD 6869", "$TD ERR,DBXTOHIVEFULL,0");
+    gw_request(client, TILE_GW_SEND, send_req, sizeof(send_req));
+    gw.process(10);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(gw_receive(client, type, payload), ==, 11);
+    munit_assert_int(payload[0], ==, TILE_COMMAND_ERROR);
+    munit_assert_int(payload[1], ==, TILE_ERR_DBXTOHIVEFULL);
+
+    // sent confirmation only goes to subscriber
+    emu_unsolicited("$TD SENT RSSI=-110,SNR=8,FDEV=-1017,6001");
+    gw.process(10);
+    munit_assert_int(gw_receive(subscriber, type, payload), ==, 14);
+    munit_assert_int(type, ==, TILE_GW_EVENT_SENT);
+    memcpy(&msg_id, payload, 8);
+    munit_assert_uint64(msg_id, ==, 6001);
+    munit_assert_int((int16_t) (payload[8] | (payload[9] << 8)), ==, -110);
+    munit_assert_int(gw_receive(client, type, payload), ==, -1);
+
+    // more confirmations between two calls than the sent log holds, none are dropped
+    char sentence[60];
+    for (int i = 0; i < TILE_SENT_LOG_COUNT + 2; i++) {
+        snprintf(sentence, sizeof(sentence), "$TD SENT RSSI=-100,SNR=8,FDEV=-1017,%d", 6100 + i);
+        emu_unsolicited(sentence);
+    }
+    gw.process(10);
+    for (int i = 0; i < TILE_SENT_LOG_COUNT + 2; i++) {
+        munit_assert_int(gw_receive(subscriber, type, payload), ==, 14);
+        munit_assert_int(type, ==, TILE_GW_EVENT_SENT);
+        memcpy(&msg_id, payload, 8);
+        munit_assert_uint64(msg_id, ==, 6100 + i);
+    }
+    munit_assert_int(gw_receive(subscriber, type, payload), ==, -1);
+
+    // inbox
+    gw.setInboxInterval(1);
+    usleep(2000);
+    tile_emu_begin("$MM C=U", "$MM 2");
+    gw.process(0);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(gw_receive(subscriber, type, payload), ==, 2);
+    munit_assert_int(type, ==, TILE_GW_EVENT_INBOX);
+    munit_assert_int(payload[0], ==, 2);
+    gw.setInboxInterval(0);
+
+    gw_request(client, TILE_GW_READ, 0, 0);
+    tile_emu_begin("$MM R=O", "$MM 6578616d706c65,21990235111426,1584494275");
+    gw.process(10);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(gw_receive(client, type, payload), ==, 2 + 14 + 7);
+    munit_assert_int(type, ==, TILE_GW_READ | TILE_GW_RESPONSE);
+    memcpy(&msg_id, payload + 4, 8);
+    munit_assert_uint64(msg_id, ==, 21990235111426ULL);
+    munit_assert_memory_equal(7, payload + 16, "example");
+
+    // unknown request
+    gw_request(client, 0x7f, 0, 0);
+    gw.process(10);
+    munit_assert_int(gw_receive(client, type, payload), ==, 2);
+    munit_assert_int(payload[0], ==, TILE_PROTOCOL_ERROR);
+
+    close(client);
+    close(subscriber);
+    gw.process(10);
+    gw.end();
+
+    return MUNIT_OK;
+}
+
+// runs a tilectl subcommand, returns exit code and output in out
+static int cli_run(const char *input, char *out, size_t out_len, bool json, int argc, const char **argv)
+{
+    FILE *in = fmemopen((void*) input, strlen(input), "r");
+    FILE *f = fmemopen(out, out_len, "w");
+    TileCli cli(tile, in, f);
+    cli.setJson(json);
+    int ret = cli.run(argc, (char**) argv);
+    fclose(f);
+    fclose(in);
+    return ret;
+}
+
+static MunitResult test_cli(const MunitParameter params[], void* data)
+{
+    char out[1000];
+    char dir[] = "/tmp/tilelib-test-XXXXXX";
+    char path[100];
+    int ret;
+
+    // one result per line, machine readable
+    const char *send_argv[] = { "send" };
+    emu_sequence_t send_seq[] = {
+        { "$TD 61", "$TD OK,7001" },
+        { "$TD 6262", "$TD ERR,DBXTOHIVEFULL,0" },
+        { 0, 0 }
+    };
+    tile_emu_begin(send_seq);
+    ret = cli_run("a\nbb\n", out, sizeof(out), true, 1, send_argv);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 1);
+    munit_assert_string_equal(out,
+        "{\"line\":1,\"status\":\"TILE_SUCCESS\",\"msg_id\":7001,\"held\":false}\n"
+        "{\"line\":2,\"status\":\"TILE_COMMAND_ERROR\",\"error\":\"DBXTOHIVEFULL\"}\n");
+
+    // line longer than the input buffer fails as a whole, no piece of it is sent
+    char long_input[1000];
+    memset(long_input, 'x', sizeof(long_input));
+    memcpy(long_input, "a\n", 2);
+    strcpy(long_input + 900, "\nbb\n");
+    emu_sequence_t long_seq[] = {
+        { "$TD 61", "$TD OK,7011" },
+        { "$TD 6262", "$TD OK,7012" },
+        { 0, 0 }
+    };
+    tile_emu_begin(long_seq);
+    ret = cli_run(long_input, out, sizeof(out), false, 1, send_argv);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 1);
+    munit_assert_string_equal(out, "1 queued 7011\n2 TILE_COMMAND_ERROR BADDATA\n3 queued 7012\n");
+
+    // messages beyond the window wait for the Tile until the time limit
+    const char *window_argv[] = { "send", "-w", "1", "-T", "2" };
+    tile_emu_begin("$TD 61", "$TD OK,7002");
+    emu_setVirtualClock(true);
+    ret = cli_run("a\nbb\n", out, sizeof(out), false, 5, window_argv);
+    emu_setVirtualClock(false);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 1);
+    munit_assert_string_equal(out, "1 queued 7002\n2 held\n");
+    tile.setOverflowQueue(0);
+
+    // status in one pipelined exchange
+    const char *status_argv[] = { "status" };
+    emu_sequence_t status_seq[] = {
+        { "$DT @", "$DT 20210611042422,V" },
+        { "$MT C=U", "$MT 12" },
+        { "$MM C=U", "$MM 2" },
+        { "$GS @", "$GS 109,214,9,0,G3" },
+        { "$GN @", "$GN 37.8921,-122.0155,77,89,2" },
+        { "$FV", "$FV 2021-11-04-16:33:05,v1.1.0" },
+        { 0, 0 }
+    };
+    tile_emu_begin(status_seq);
+    ret = cli_run("", out, sizeof(out), false, 1, status_argv);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 0);
+    munit_assert_not_null(strstr(out, "datetime 2021-06-11 04:24:22\n"));
+    munit_assert_not_null(strstr(out, "unsent 12\nunread 2\n"));
+    munit_assert_not_null(strstr(out, "version v1.1.0\n"));
+
+    // inbox to files
+    munit_assert_not_null(mkdtemp(dir));
+    const char *drain_argv[] = { "drain", dir };
+    emu_sequence_t drain_seq[] = {
+        { "$MM C=U", "$MM 1" },
+        { "$MM R=O", "$MM 6578616d706c65,21990235111426,1584494275" },
+        { 0, 0 }
+    };
+    tile_emu_begin(drain_seq);
+    ret = cli_run("", out, sizeof(out), false, 2, drain_argv);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 0);
+    snprintf(path, sizeof(path), "%s/21990235111426.bin", dir);
+    FILE *f = fopen(path, "rb");
+    munit_assert_not_null(f);
+    munit_assert_int(fread(out, 1, sizeof(out), f), ==, 7);
+    munit_assert_memory_equal(7, out, "example");
+    fclose(f);
+    unlink(path);
+    rmdir(dir);
+
+    const char *delete_argv[] = { "delete", "read" };
+    tile_emu_begin("$MM D=R", "$MM 3");
+    ret = cli_run("", out, sizeof(out), false, 2, delete_argv);
+    tile_emu_end(TILE_SUCCESS);
+    munit_assert_int(ret, ==, 0);
+    munit_assert_string_equal(out, "deleted 3\n");
+
+    // unsolicited messages as received
+    const char *tail_argv[] = { "tail", "-n", "1", "-t", "1" };
+    emu_unsolicited("$TD SENT RSSI=-110,SNR=8,FDEV=-1017,7001");
+    ret = cli_run("", out, sizeof(out), false, 5, tail_argv);
+    munit_assert_int(ret, ==, 0);
+    munit_assert_string_equal(out, "$TD SENT RSSI=-110,SNR=8,FDEV=-1017,7001\n");
+
+    // unknown subcommand
+    const char *bad_argv[] = { "launch" };
+    munit_assert_int(cli_run("", out, sizeof(out), false, 1, bad_argv), ==, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_tileSim(const MunitParameter params[], void* data)
+{
+    SerialEmu sim_serial;
+    TileSim *sim = new TileSim(sim_serial);
+    SwarmTile sim_tile(sim_serial);
+    pthread_t sim_th;
+    tile_status_t result;
+    tile_version_t version;
+    tile_msg_count_t count;
+    tile_send_msg_t msg;
+    tile_link_stats_t link;
+    tile_sim_stats_t stats;
+    char buf[TILE_MAX_MSG_SIZE];
+
+    // one simulated second per millisecond, pass every minute sends up to 10 messages
+    sim->setTimeScale(1000);
+    sim->setPasses(60, 30, 10);
+    sim->inject("hello", 5, 7);
+    pthread_create(&sim_th, NULL, &TileSim::run, sim);
+    sim_tile.setTimeout(200);
+    sim_tile.begin();
+
+    munit_assert_int(sim_tile.getVersion(version), ==, TILE_SUCCESS);
+    munit_assert_int(version.minor, ==, 1);
+
+    uint64_t first_id = 0;
+    for (int i = 0; i < 3; i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.message = "abc";
+        msg.msg_len = 3;
+        munit_assert_int(sim_tile.sendMessage(msg), ==, TILE_SUCCESS);
+        munit_assert_true(msg.msg_id > first_id);
+        first_id = msg.msg_id;
+    }
+
+    // hold time out of range
+    memset(&msg, 0, sizeof(msg));
+    msg.message = "abc";
+    msg.msg_len = 3;
+    msg.hold_time = 10;
+    munit_assert_int(sim_tile.sendMessage(msg), ==, TILE_COMMAND_ERROR);
+    munit_assert_int(sim_tile.getError(), ==, TILE_ERR_BADHOLDTIME);
+
+    // next pass sends queued messages and delivers injected message
+    unsigned long start = millis();
+    do {
+        sim_tile.poll();
+        sim_tile.getLinkStats(link);
+    } while (link.sent < 3 && millis() - start < 2000);
+    munit_assert_int(link.sent, ==, 3);
+    munit_assert_int(link.tracked, ==, 3);
+    munit_assert_int(sim_tile.getUnsentCount(count), ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 0);
+
+    munit_assert_int(sim_tile.readMessage(buf, sizeof(buf)), ==, 5);
+    munit_assert_memory_equal(5, buf, "hello");
+    munit_assert_int(sim_tile.readMessage(buf, sizeof(buf)), ==, 0);
+    munit_assert_int(sim_tile.getError(), ==, TILE_ERR_DBXNOMORE);
+    munit_assert_int(sim_tile.deleteReadMsgs(count), ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 1);
+
+    // serial activity wakes Tile
+    tile_sleep_t sleep;
+    memset(&sleep, 0, sizeof(sleep));
+    sleep.seconds = 3600;
+    munit_assert_int(sim_tile.sleep(sleep), ==, TILE_SUCCESS);
+    munit_assert_int(sim_tile.wake(), ==, TILE_SUCCESS);
+    munit_assert_int(sim_tile.wake(), ==, TILE_COMMAND_ERROR);
+
+    // database reinitialization reboots Tile, no pass may send the message before
+    tile_response_t response;
+    sim->setPasses(0, 0, 0);
+    munit_assert_int(sim_tile.sendMessage("abc"), ==, TILE_SUCCESS);
+    result = sim_tile.command("$RS dbinit", response);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    usleep(20000);
+    munit_assert_true(sim_tile.isReady());
+    munit_assert_int(sim_tile.getUnsentCount(), ==, 0);
+
+    sim->getStats(stats);
+    munit_assert_int(stats.accepted, ==, 4);
+    munit_assert_int(stats.rejected, ==, 1);
+    munit_assert_int(stats.sent, ==, 3);
+    munit_assert_int(stats.received, ==, 1);
+    munit_assert_int(stats.bad_lines, ==, 0);
+
+    sim->stop();
+    pthread_join(sim_th, NULL);
+    delete sim;
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_linkModel(const MunitParameter params[], void* data)
+{
+    static const emu_delay_t delays[] = {
+        { "$MT C=U", 50000, 0 },
+        { "$FV", 10000, 5000 },
+        { 0, 0, 0 }
+    };
+    tile_status_t result;
+    tile_msg_count_t count;
+    tile_version_t version;
+
+    serial.setBaudRate(9600);
+    serial.setDelays(delays);
+    tile.setTimeout(200);
+
+    // 11 bytes command and 10 bytes response at 1042 us each plus processing time
+    tile_emu_begin("$MT C=U", "$MT 12");
+    unsigned long start = micros();
+    result = tile.getUnsentCount(count);
+    unsigned long elapsed = micros() - start;
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_int(count.count, ==, 12);
+    munit_assert_ulong(elapsed, >=, 71000);
+    munit_assert_ulong(elapsed, <, 150000);
+
+    // processing time with jitter
+    for (int i = 0; i < 3; i++) {
+        tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+        start = micros();
+        result = tile.getVersion(version);
+        elapsed = micros() - start;
+        tile_emu_end(result);
+        munit_assert_int(result, ==, TILE_SUCCESS);
+        munit_assert_ulong(elapsed, >=, 5000 + 41 * 1042);
+        munit_assert_ulong(elapsed, <, 100000);
+    }
+
+    // Tile answers after timeout expired
+    tile.setTimeout(60);
+    tile_emu_begin("$MT C=U", "$MT 12");
+    result = tile.getUnsentCount(count);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_TIMEOUT);
+    usleep(50000);
+    while (serial.read() >= 0);
+
+    serial.setBaudRate(0);
+    serial.setDelays(0);
+    tile.setTimeout(100);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_virtualClock(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_msg_count_t count;
+    unsigned long start;
+
+    emu_setVirtualClock(true);
+    tile.setWaitHook(SerialEmu::waitHook, &serial);
+    tile.setTimeout(1000);
+
+    // timeouts expire without sleeping
+    for (int i = 0; i < 1000; i++) {
+        tile_emu_begin("$MT C=U", NULL);
+        start = micros();
+        result = tile.getUnsentCount(count);
+        tile_emu_end(result);
+        munit_assert_int(result, ==, TILE_TIMEOUT);
+        munit_assert_ulong(micros() - start, ==, 1001000);
+    }
+
+    // retries with backoff
+    emu_sequence_t retry_seq[] = {
+        { "$MT L=U", "$MT 0" },
+        { "$TD 64", NULL },
+        { "$MT L=U", "$MT 0" },
+        { "$TD 64", NULL },
+        { "$MT L=U", "$MT 0" },
+        { "$TD 64", "$TD OK,5005" },
+        { 0, 0 }
+    };
+    tile.setSendRetry(2, 500);
+    tile_emu_begin(retry_seq);
+    start = micros();
+    result = tile.sendMessage("d");
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_ulong(micros() - start, ==, 1001000 + 500000 + 1001000 + 1000000);
+    tile.setSendRetry(0);
+
+    // link model runs on virtual time, 21 bytes at 9600 baud plus processing time
+    static const emu_delay_t delays[] = {
+        { "$MT C=U", 50000, 0 },
+        { 0, 0, 0 }
+    };
+    serial.setBaudRate(9600);
+    serial.setDelays(delays);
+    tile_emu_begin("$MT C=U", "$MT 12");
+    start = micros();
+    result = tile.getUnsentCount(count);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    munit_assert_ulong(micros() - start, ==, 21 * 1042 + 50000);
+    serial.setDelays(0);
+
+    // periodic message every 47 ms at 9600 baud but no OK, command times out after 1 second
+    char response[50 * 30];
+    char line[50];
+    response[0] = 0;
+    for (int i = 0; i < 30; i++) {
+        strcat(response, nmea(line, sizeof(line), "$PW 3.20000,0.00000,0.00000,0.00000,30.0"));
+    }
+    tile_emu_begin("$PW 60", response);
+    start = micros();
+    result = tile.setPowerStatusRate(60);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_TIMEOUT);
+    munit_assert_ulong(micros() - start, <, 1100000);
+    emu_advanceClock(2000000);
+    while (serial.read() >= 0);
+    serial.setBaudRate(0);
+
+    tile.setWaitHook(0);
+    tile.setTimeout(100);
+    emu_setVirtualClock(false);
+
+    return MUNIT_OK;
+}
+
+#define RING_TEST_BYTES 1000000
+
+static void *ring_producer(void *context)
+{
+    SerialBuffer *ring = (SerialBuffer*) context;
+    char chunk[700];
+    uint32_t sent = 0;
+    size_t size = 1;
+
+    while (sent < RING_TEST_BYTES) {
+        size = size * 7 % sizeof(chunk) + 1;
+        if (size > RING_TEST_BYTES - sent) {
+            size = RING_TEST_BYTES - sent;
+        }
+        for (size_t i = 0; i < size; i++) {
+            chunk[i] = (char) ((sent + i) % 251);
+        }
+        size_t written = ring->write(chunk, size);
+        sent += written;
+        if (written < size) {
+            // full, keep unwritten bytes for next round
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+static MunitResult test_serialBuffer(const MunitParameter params[], void* data)
+{
+    SerialBuffer *ring = new SerialBuffer();
+    pthread_t producer;
+    char buf[EMU_BUFFER_LEN + 10];
+
+    // full ring drops what doesn't fit
+    memset(buf, 'a', sizeof(buf));
+    munit_assert_int(ring->write(buf, sizeof(buf)), ==, EMU_BUFFER_LEN);
+    munit_assert_int(ring->available(), ==, EMU_BUFFER_LEN);
+    munit_assert_int(ring->read(buf, 10), ==, 10);
+    munit_assert_int(ring->write("bc", 2), ==, 2);
+    munit_assert_int(ring->read(buf, sizeof(buf)), ==, EMU_BUFFER_LEN - 8);
+    munit_assert_memory_equal(2, buf + EMU_BUFFER_LEN - 10, "bc");
+    munit_assert_int(ring->read(), ==, -1);
+
+    // idle reader sleeps until bytes arrive or timeout
+    munit_assert_false(ring->wait(1000));
+    ring->wakeup();
+    munit_assert_false(ring->wait(1000000));
+
+    // bytes cross over between threads in order
+    pthread_create(&producer, NULL, ring_producer, ring);
+    uint32_t received = 0;
+    while (received < RING_TEST_BYTES) {
+        if (!ring->wait(1000000)) {
+            break;
+        }
+        size_t len = ring->read(buf, 333);
+        for (size_t i = 0; i < len; i++) {
+            munit_assert_int((uint8_t) buf[i], ==, (received + i) % 251);
+        }
+        received += len;
+    }
+    pthread_join(producer, NULL);
+    munit_assert_int(received, ==, RING_TEST_BYTES);
+    delete ring;
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_replay(const MunitParameter params[], void* data)
+{
+    SerialEmu trace_stream;
+    tile_status_t result;
+    tile_version_t version;
+    char line[100];
+    char noisy[120];
+    char buf[TILE_MAX_MSG_SIZE];
+    char trace[2000];
+    size_t trace_len = 0;
+
+    // record session in trace format, noise before the sentence gets escaped
+    tile.setDebugStream(&trace_stream, TILE_DEBUG_TRACE);
+    tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+    snprintf(noisy, sizeof(noisy), "\x01\\%s", nmea(line, sizeof(line), "$MM 6578616d706c65,21990235111426,1584494275"));
+    tile_emu_begin("$MM R=O", noisy);
+    munit_assert_int(tile.readMessage(buf, sizeof(buf)), ==, 7);
+    tile_emu_end(TILE_SUCCESS);
+    tile.setDebugStream(0);
+    while (trace_stream.emu_available()) {
+        trace_len += trace_stream.emu_read(trace + trace_len, sizeof(trace) - 1 - trace_len);
+    }
+    trace[trace_len] = 0;
+    munit_assert_not_null(strstr(trace, " T $FV*10\n"));
+    munit_assert_not_null(strstr(trace, " R \\x01\\x5c$MM 6578616d706c65,"));
+
+    // store trace as tilectl -t does
+    char path[] = "/tmp/tilereplayXXXXXX";
+    int fd = mkstemp(path);
+    munit_assert_int(fd, >=, 0);
+    close(fd);
+    HostFile file;
+    munit_assert_true(file.begin(path));
+    file.write((const uint8_t*) trace, trace_len);
+    file.end();
+
+    // same calls against replayed trace
+    SerialEmu replay_serial;
+    TileReplay *replay = new TileReplay(replay_serial);
+    SwarmTile replay_tile(replay_serial);
+    tile_replay_stats_t stats;
+    pthread_t replay_th;
+    munit_assert_true(replay->loadFile(path));
+    unlink(path);
+    replay->setSpeed(0);
+    replay_tile.setTimeout(500);
+    pthread_create(&replay_th, NULL, &TileReplay::run, replay);
+    munit_assert_int(replay_tile.getVersion(version), ==, TILE_SUCCESS);
+    munit_assert_string_equal(version.version_str, "v1.0.0");
+    memset(buf, 0, sizeof(buf));
+    munit_assert_int(replay_tile.readMessage(buf, sizeof(buf)), ==, 7);
+    munit_assert_string_equal(buf, "example");
+    pthread_join(replay_th, NULL);
+    replay->getStats(stats);
+    munit_assert_true(stats.done);
+    munit_assert_int(stats.commands, ==, 2);
+    munit_assert_int(stats.mismatches, ==, 0);
+    munit_assert_int(stats.responses, ==, 2);
+
+    // original timing, compressed in time
+    snprintf(trace, sizeof(trace), "# delayed response\n1000 T $FV*10\n1300 R %s",
+             nmea(line, sizeof(line), "$FV 2021-03-23-18:25:40,v1.0.0"));
+    munit_assert_true(replay->load(trace));
+    for (int speed = 1; speed <= 10; speed *= 10) {
+        replay->setSpeed(speed);
+        pthread_create(&replay_th, NULL, &TileReplay::run, replay);
+        unsigned long start = millis();
+        munit_assert_int(replay_tile.getVersion(version), ==, TILE_SUCCESS);
+        unsigned long elapsed = millis() - start;
+        pthread_join(replay_th, NULL);
+        munit_assert_ulong(elapsed, >=, 300 / speed);
+        munit_assert_ulong(elapsed, <, 300 / speed + 100);
+    }
+
+    // library sends different command
+    replay->setSpeed(0);
+    replay_tile.setTimeout(100);
+    pthread_create(&replay_th, NULL, &TileReplay::run, replay);
+    munit_assert_int(replay_tile.getUnsentCount(), ==, 0);
+    pthread_join(replay_th, NULL);
+    replay->getStats(stats);
+    munit_assert_int(stats.mismatches, ==, 1);
+    munit_assert_int(stats.first_mismatch, ==, 2);
+    replay->getMismatch(line, sizeof(line));
+    munit_assert_string_equal(line, "$MT C=U*12");
+    while (replay_serial.read() >= 0);
+
+    munit_assert_false(replay->load("1000 X $FV*10\n"));
+    munit_assert_false(replay->load("T $FV*10\n"));
+    delete replay;
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_faults(const MunitParameter params[], void* data)
+{
+    tile_status_t result;
+    tile_version_t version;
+
+    // scripted Tile withholds or corrupts next response
+    tile_emu.setNextError(ERR_TIMEOUT);
+    tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_TIMEOUT);
+
+    tile_emu.setNextError(ERR_CRC);
+    tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_PROTOCOL_ERROR);
+
+    tile_emu_begin("$FV", "$FV 2021-03-23-18:25:40,v1.0.0");
+    result = tile.getVersion(version);
+    tile_emu_end(result);
+    munit_assert_int(result, ==, TILE_SUCCESS);
+
+    // simulated Tile behind a faulty link
+    SerialEmu sim_serial;
+    TileSim *sim = new TileSim(sim_serial);
+    SwarmTile sim_tile(sim_serial);
+    TileRecovery recovery;
+    tile_recovery_stats_t stats;
+    emu_fault_stats_t faults_seen;
+    pthread_t sim_th;
+
+    emu_faults_t faults;
+    memset(&faults, 0, sizeof(faults));
+    faults.drop = 0.002;
+    faults.flip = 0.002;
+    faults.truncate = 0.03;
+    faults.duplicate = 0.03;
+    faults.burst = 0.03;
+    faults.burst_len = 5;
+    faults.delay = 0.03;
+    faults.delay_us = 80000;
+    faults.reboot = 0.02;
+
+    // timeouts run on virtual time
+    emu_setVirtualClock(true);
+    sim->setPasses(0, 0, 0);
+    pthread_create(&sim_th, NULL, &TileSim::run, sim);
+    sim_tile.setTimeout(50);
+    sim_tile.setWaitHook(SerialEmu::waitHook, &sim_serial);
+    sim_serial.setSeed(42);
+    sim_serial.setFaults(&faults);
+
+    for (int i = 0; i < 400; i++) {
+        recovery.begin();
+        result = sim_tile.getVersion(version);
+        recovery.end(result == TILE_SUCCESS && strcmp(version.version_str, "v1.1.0") == 0);
+    }
+    sim_serial.getFaultStats(faults_seen);
+    munit_assert_int(faults_seen.dropped, >, 0);
+    munit_assert_int(faults_seen.flipped, >, 0);
+    munit_assert_int(faults_seen.truncated, >, 0);
+    munit_assert_int(faults_seen.duplicated, >, 0);
+    munit_assert_int(faults_seen.bursts, >, 0);
+    munit_assert_int(faults_seen.delayed, >, 0);
+    munit_assert_int(faults_seen.reboots, >, 0);
+
+    // clean link, library is back in sync with the next call
+    sim_serial.setFaults(0);
+    for (int i = 0; i < 10; i++) {
+        recovery.begin();
+        result = sim_tile.getVersion(version);
+        recovery.end(result == TILE_SUCCESS && strcmp(version.version_str, "v1.1.0") == 0);
+        munit_assert_int(result, ==, TILE_SUCCESS);
+    }
+
+    recovery.getStats(stats);
+    munit_assert_int(stats.operations, ==, 410);
+    munit_assert_int(stats.failures, >, 0);
+    munit_assert_int(stats.recoveries, >, 0);
+    munit_assert_true(stats.recovered);
+    munit_assert_int(stats.max_failed_ops, <=, 3);
+    munit_assert_ulong(stats.max_recovery_us, >=, stats.mean_recovery_us);
+    if (verbose) {
+        printf("\n%u failures, mean recovery %lu us, max %lu us\n",
+               stats.failures, stats.mean_recovery_us, stats.max_recovery_us);
+    }
+
+    sim->stop();
+    pthread_join(sim_th, NULL);
+    delete sim;
+    emu_setVirtualClock(false);
 
     return MUNIT_OK;
 }
 
 static MunitTest test_suite_tests[] = {
     { (char*) "NMEA message parsing", test_nmeaParsing, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "RX resynchronisation", test_rxResync, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getVersion", test_getVersion, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "firmware capabilities", test_capabilities, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getConfig", test_getConfig, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "setGpioMode", test_setGpioMode, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "GPIO signalling", test_gpio, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "sleep", test_sleep, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "wake", test_wake, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "powerOff", test_powerOff, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getDateTime", test_getDateTime, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getGeoData", test_getGeoData, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "getStatusSnapshot", test_getStatusSnapshot, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "getPowerStatus", test_getPowerStatus, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "getJammingStatus", test_getJammingStatus, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getUnsentCount", test_getUnsentCount, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "getUnreadCount", test_getUnreadCount, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "deleteUnsentMsgs", test_deleteUnsentMsgs, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "deleteReadMsgs", test_deleteReadMsgs, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "sendMessage", test_sendMessage, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { (char*) "readMessage", test_readMessage, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "command", test_command, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "receive test", test_receiveTest, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "link statistics", test_linkStats, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "TileQueue", test_queue, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "overflow queue", test_overflowQueue, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "send window", test_sendWindow, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "database recovery", test_dbRecovery, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "sendMessage retry", test_sendRetry, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "host serial", test_hostSerial, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "gateway", test_gateway, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "command line tool", test_cli, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "Tile simulator", test_tileSim, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "serial link model", test_linkModel, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "virtual clock", test_virtualClock, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "SerialBuffer", test_serialBuffer, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "trace replay", test_replay, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    { (char*) "fault injection", test_faults, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
     { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -668,6 +2610,31 @@ void tile_emu_end(tile_status_t result)
     pthread_join(th, NULL);
 }
 
+// append checksum and newline to NMEA sentence
+const char *nmea(char *buf, size_t buf_len, const char *sentence)
+{
+    uint8_t cs = 0;
+    const char *c = sentence + 1;
+    while (*c) {
+        cs ^= (uint8_t) *c;
+        c++;
+    }
+    snprintf(buf, buf_len, "%s*%02x\n", sentence, cs);
+    return buf;
+}
+
+// queue unsolicited sentence from Tile, appends checksum unless sentence already has one
+void emu_unsolicited(const char *sentence)
+{
+    char buf[TILE_RX_BUFFER_SIZE + 10];
+    if (strchr(sentence, '*')) {
+        snprintf(buf, sizeof(buf), "%s\n", sentence);
+    } else {
+        nmea(buf, sizeof(buf), sentence);
+    }
+    serial.emu_write(buf);
+}
+
 void print_result(tile_status_t result)
 {
     switch (result) {
@@ -1,5 +1,6 @@
 
 #include "SwarmTile.h"
+#include "TileQueue.h"
 #include "Arduino.h"
 #include <time.h>
 #include <stdlib.h>
@@ -9,15 +10,26 @@
 #define TILE_TIMEOUT_CHECK { if (millis() - _timeout_start > _timeout_ms) return TILE_TIMEOUT; }
 
 static const char _hex[] PROGMEM = "0123456789abcdef";
+// queries of getStatusSnapshot, in order of tile_status_snapshot_t
+#define TILE_SNAPSHOT_CMD_COUNT 6
+static const char *const _snapshot_cmds[TILE_SNAPSHOT_CMD_COUNT] = {
+    "$DT @", "$MT C=U", "$MM C=U", "$GS @", "$GN @", "$FV"
+};
+// upper bound of latency histogram buckets in seconds, last bucket is open ended
+static const uint32_t _latency_buckets[TILE_LATENCY_BUCKETS-1] = {
+    60, 300, 900, 3600, 14400, 43200, 86400
+};
 static inline uint8_t _hexToInt(char c) {
     return isdigit(c) ? c - '0' : (c & 0x0f) + 9;
 }
 
-// static int32_t _strToInt(const char* str, size_t len);
+static int32_t _strToInt(const char* str, size_t len);
+static tile_error_t _lookupError(const char* str);
 static uint64_t _strToUInt(const char* str, size_t len);
-static time_t _makeEpoch(tile_datetime_t &datetime);
+static time_t _makeEpoch(const tile_datetime_t &datetime);
 static void _makeDatetime(tile_datetime_t &datetime, time_t epoch);
 static bool _nmeaValidate(const char* msg, size_t len);
+static uint8_t _keyHash(const char* key, size_t len);
 
 SwarmTile::SwarmTile(Stream &str) : _stream(str)
 {
@@ -26,15 +38,54 @@ SwarmTile::SwarmTile(Stream &str) : _stream(str)
     _tx_pos = 0;
     _tx_checksum = 0;
     _debug = 0;
+    _debug_format = TILE_DEBUG_RAW;
+    _trace_dir = 0;
+    _wait_hook = 0;
+    _wait_context = 0;
+    _unsolicited_hook = 0;
+    _unsolicited_context = 0;
+    _gpio_pin = TILE_GPIO_NO_PIN;
+    _gpio_mode = TILE_GPIO_ANALOG;
+    _gpio_isr = 0;
+    _rx_line_done = false;
+    _rx_skip = false;
+    resetRxStats();
+    _setErrorStr(0);
+    resetReceiveTestStats();
+    resetLinkStats();
+    memset(&_power, 0, sizeof(_power));
+    memset(&_jamming, 0, sizeof(_jamming));
+    _power_rate = 0;
+    _jamming_rate = 0;
+    _power_ms = 0;
+    _jamming_ms = 0;
+    _queue = 0;
+    _queue_ready = false;
+    _queue_full_ms = 0;
+    _send_window = 0;
+    _in_flight = 0;
+    _in_flight_ms = 0;
+    _db_threshold = 0;
+    _db_full_count = 0;
+    _db_recovery_armed = true;
+    _db_recoveries = 0;
+    _capabilities = 0;
+    _capabilities_valid = false;
+    _send_retries = 0;
+    _retry_backoff_ms = TILE_RETRY_BACKOFF_MS;
 }
 
 tile_status_t SwarmTile::begin()
 {
     _rx_buf_pos = 0;
+    _rx_line_done = false;
     memset(_rx_buffer, 0, sizeof(_rx_buffer));
     memset(_rx_fields, 0, sizeof(_rx_fields));
+    memset(_rx_keys, -1, sizeof(_rx_keys));
     _tx_pos = 0;
     _tx_checksum = 0;
+    // Tile may have been replaced or updated
+    _capabilities_valid = false;
     _flushStream();
     return TILE_SUCCESS;
 }
@@ -80,15 +131,34 @@ tile_status_t SwarmTile::getVersion(tile_version_t &version)
         return result;
     }
 
-    if (_rx_field_count != 2) {
-        return TILE_PROTOCOL_ERROR;
+    return _parseVersion(version);
+}
+
+bool SwarmTile::hasCapability(tile_capability_t capability)
+{
+    tile_version_t version;
+
+    if (!_capabilities_valid) {
+        // fills capabilities
+        getVersion(version);
     }
 
-    strncpy(version.date_str, _rx_fields[1], sizeof(version.date_str)-1);
-    strncpy(version.version_str, _rx_fields[2], sizeof(version.version_str)-1);
-    version.valid = true;
+    return _capabilities_valid && (_capabilities & capability);
+}
 
-    return TILE_SUCCESS;
+void SwarmTile::_setCapabilities(const tile_version_t &version)
+{
+    _capabilities = 0;
+    if (version.major > 1 || (version.major == 1 && version.minor >= 1)) {
+        _capabilities |= TILE_CAP_APP_ID | TILE_CAP_DB_FIXED;
+    }
+    _capabilities_valid = true;
+}
+
+// returns false only if firmware is known to lack capability, avoids $FV round trip
+bool SwarmTile::_assumeCapability(tile_capability_t capability)
+{
+    return !_capabilities_valid || (_capabilities & capability);
 }
 
 tile_status_t SwarmTile::getConfig(tile_config_t &config)
@@ -103,18 +173,16 @@ tile_status_t SwarmTile::getConfig(tile_config_t &config)
         return result;
     }
 
-    uint8_t i = 1;
-    while (i <= _rx_field_count) {
-        if (strncmp(_rx_fields[i], "AI=", 3) == 0) {
-            config.app_id = _strToUInt(_rx_fields[i]+3, strlen(_rx_fields[i])-3);
-        } else if (strncmp(_rx_fields[i], "DI=", 3) == 0) {
-            config.device_id = _strToUInt(_rx_fields[i]+3, strlen(_rx_fields[i])-3);
-        } else if (strncmp(_rx_fields[i], "DN=", 3) == 0) {
-            strncpy(config.device_type, _rx_fields[i]+3, sizeof(config.device_type)-1);
-        } else {
-            // ignore unknown fields
-        }
-        i++;
+    // unknown fields are ignored
+    int8_t f;
+    if ((f = _fieldKey("AI")) >= 0) {
+        config.app_id = _fieldUInt(f, 3);
+    }
+    if ((f = _fieldKey("DI")) >= 0) {
+        config.device_id = _fieldUInt(f, 3);
+    }
+    if ((f = _fieldKey("DN")) >= 0) {
+        _fieldCopy(f, config.device_type, sizeof(config.device_type), 3);
     }
     config.valid = true;
 
@@ -134,6 +202,83 @@ tile_status_t SwarmTile::setGpioMode(uint8_t mode)
     return _receiveResponse("$GP");
 }
 
+tile_status_t SwarmTile::setGpioMode(tile_gpio_mode_t mode)
+{
+    return setGpioMode((uint8_t) mode);
+}
+
+tile_status_t SwarmTile::getGpioMode(tile_gpio_mode_t &mode)
+{
+    tile_status_t result;
+
+    result = _sendCommand("$GP ?");
+    if (result != TILE_SUCCESS) {
+        return result;
+    }
+
+    if (_rx_field_count != 1 || !_fieldIsNumber(1)) {
+        return TILE_PROTOCOL_ERROR;
+    }
+
+    mode = (tile_gpio_mode_t) _fieldUInt(1);
+
+    return TILE_SUCCESS;
+}
+
+tile_status_t SwarmTile::attachGpioPin(uint8_t pin, tile_gpio_mode_t mode, void (*isr)(void))
+{
+    tile_status_t result;
+
+    detachGpioPin();
+
+    if (mode < TILE_GPIO_MSG_PENDING_LOW) {
+        // input or static output modes don't signal anything to the MCU
+        _setErrorStr("BADGPIOMODE");
+        return TILE_COMMAND_ERROR;
+    }
+
+    result = setGpioMode(mode);
+    if (result != TILE_SUCCESS) {
+        return result;
+    }
+
+    _gpio_pin = pin;
+    _gpio_mode = mode;
+    _gpio_isr = isr;
+    pinMode(pin, INPUT);
+
+    if (isr) {
+        // odd modes signal with low level, even modes with high level
+        attachInterrupt(digitalPinToInterrupt(pin), isr, (mode & 1) ? FALLING : RISING);
+    }
+
+    return TILE_SUCCESS;
+}
+
+void SwarmTile::detachGpioPin()
+{
+    if (_gpio_pin != TILE_GPIO_NO_PIN && _gpio_isr) {
+        detachInterrupt(digitalPinToInterrupt(_gpio_pin));
+    }
+    _gpio_pin = TILE_GPIO_NO_PIN;
+    _gpio_mode = TILE_GPIO_ANALOG;
+    _gpio_isr = 0;
+}
+
+bool SwarmTile::isGpioActive()
+{
+    if (_gpio_pin == TILE_GPIO_NO_PIN) {
+        return false;
+    }
+
+    // odd modes signal with low level, even modes with high level
+    if (_gpio_mode & 1) {
+        return digitalRead(_gpio_pin) == LOW;
+    } else {
+        return digitalRead(_gpio_pin) == HIGH;
+    }
+}
+
 tile_status_t SwarmTile::sleep(tile_sleep_t &sleep)
 {
     tile_status_t result;
@@ -158,7 +303,7 @@ tile_status_t SwarmTile::sleep(tile_sleep_t &sleep)
     result = _receiveResponse("$SL");
 
     if (result == TILE_SUCCESS) {
-        if (_rx_field_count == 1 && strcmp(_rx_fields[1], "OK") == 0) {
+        if (_rx_field_count == 1 && _fieldEquals(1, "OK")) {
             // ok
             sleep.valid = true;
             return TILE_SUCCESS;
@@ -181,7 +326,7 @@ tile_status_t SwarmTile::wake()
         return TILE_PROTOCOL_ERROR;
     }
 
-    if (strcmp(_rx_fields[1], "WAKE") != 0) {
+    if (!_fieldEquals(1, "WAKE")) {
         // tile wasn't sleeping
         _setErrorStr("NOTSLEEPING");
         return TILE_COMMAND_ERROR;
@@ -203,7 +348,7 @@ tile_status_t SwarmTile::powerOff()
         return TILE_PROTOCOL_ERROR;
     }
 
-    if (strcmp(_rx_fields[1], "OK") != 0) {
+    if (!_fieldEquals(1, "OK")) {
         // unexpected response
         return TILE_COMMAND_ERROR;
     }
@@ -211,6 +356,31 @@ tile_status_t SwarmTile::powerOff()
     return TILE_SUCCESS;
 }
 
+tile_status_t SwarmTile::command(const char *cmd, tile_response_t &response)
+{
+    tile_status_t result;
+
+    memset(&response, 0, sizeof(tile_response_t));
+    response.valid = false;
+
+    if (cmd == 0 || cmd[0] != '$' || strlen(cmd) < 3) {
+        _setErrorStr("BADPARAM");
+        return TILE_COMMAND_ERROR;
+    }
+
+    result = _sendCommand(cmd);
+    if (result != TILE_SUCCESS && result != TILE_COMMAND_ERROR) {
+        return result;
+    }
+
+    // also return fields of ERR responses
+    memcpy(response.fields, _rx_fields, sizeof(response.fields));
+    response.field_count = _rx_field_count;
+    response.valid = true;
+
+    return result;
+}
+
 tile_status_t SwarmTile::getDateTime(tile_datetime_t &datetime)
 {
     tile_status_t result;
@@ -223,22 +393,12 @@ tile_status_t SwarmTile::getDateTime(tile_datetime_t &datetime)
         return result;
     }
 
-    if (_rx_field_count != 2 || strlen(_rx_fields[1]) != 14) {
-        return TILE_PROTOCOL_ERROR;
-    }
-
-    datetime.year = _strToUInt(_rx_fields[1], 4);
-    datetime.month = _strToUInt(_rx_fields[1]+4, 2);
-    datetime.day = _strToUInt(_rx_fields[1]+6, 2);
-    datetime.hour = _strToUInt(_rx_fields[1]+8, 2);
-    datetime.minute = _strToUInt(_rx_fields[1]+10, 2);
-    datetime.second = _strToUInt(_rx_fields[1]+12, 2);
-
-    if (strncmp(_rx_fields[2],"V", 1) == 0) {
-        datetime.valid = true;
-    }
+    return _parseDateTime(datetime);
+}
 
-    return TILE_SUCCESS;   
+uint32_t SwarmTile::makeEpoch(const tile_datetime_t &datetime)
+{
+    return _makeEpoch(datetime);
 }
 
 tile_status_t SwarmTile::getGeoData(tile_geo_data_t &geo_data)
@@ -253,36 +413,181 @@ tile_status_t SwarmTile::getGeoData(tile_geo_data_t &geo_data)
         return result;
     }
 
-    if (_rx_field_count != 5) {
-        return TILE_PROTOCOL_ERROR;
+    result = _parseGeoFix();
+    if (result != TILE_SUCCESS) {
+        return result;
     }
 
-    if (strcmp(_rx_fields[5], "NF") == 0) {
-        return TILE_NO_GPS_FIX;
+    result = _sendCommand("$GN @");
+    if (result != TILE_SUCCESS) {
+        return result;
     }
 
-    result = _sendCommand("$GN @");
+    return _parseGeoData(geo_data);
+}
+
+tile_status_t SwarmTile::getStatusSnapshot(tile_status_snapshot_t &snapshot)
+{
+    tile_status_t result = TILE_SUCCESS;
+    uint8_t pending = 0;    // bit per query still waiting for response
+    uint8_t i;
+
+    memset(&snapshot, 0, sizeof(tile_status_snapshot_t));
+
+    // clear pending serial buffer to have room for responses
+    _flushStream();
+
+    // write all queries back-to-back, Tile answers them one after another
+    for (i = 0; i < TILE_SNAPSHOT_CMD_COUNT; i++) {
+        _sendBegin();
+        _send(_snapshot_cmds[i]);
+        _sendEnd();
+        pending |= 1 << i;
+    }
+
+    _setErrorStr(0);
+    TILE_TIMEOUT_START
+
+    while (pending) {
+        result = _readLine();
+        if (result == TILE_TIMEOUT) {
+            break;
+        }
+        if (_isUnsolicited()) {
+            _processUnsolicited();
+            continue;
+        }
+        if (!_validLine() || _parseResponse() != TILE_SUCCESS || _rx_fields[1].ptr == 0) {
+            // corrupted response, query stays pending
+            continue;
+        }
+
+        // demultiplex response by command
+        for (i = 0; i < TILE_SNAPSHOT_CMD_COUNT; i++) {
+            if (_rx_fields[0].len == 3 && strncmp(_rx_fields[0].ptr, _snapshot_cmds[i], 3) == 0) {
+                break;
+            }
+        }
+        if (i == TILE_SNAPSHOT_CMD_COUNT || !(pending & (1 << i))) {
+            _dispatchUnsolicited();
+            continue;
+        }
+        pending &= ~(1 << i);
+
+        // Tile is still answering, restart timeout for next response
+        TILE_TIMEOUT_START
+
+        if (_fieldEquals(1, "ERR")) {
+            // member stays invalid
+            continue;
+        }
+
+        switch (i) {
+        case 0: _parseDateTime(snapshot.datetime); break;
+        case 1: _parseMsgCount(snapshot.unsent); break;
+        case 2: _parseMsgCount(snapshot.unread); break;
+        case 3: snapshot.gps_fix = (_parseGeoFix() == TILE_SUCCESS); break;
+        case 4: _parseGeoData(snapshot.geo_data); break;
+        case 5: _parseVersion(snapshot.version); break;
+        }
+    }
+
+    if (!snapshot.gps_fix) {
+        // $GN reports zeros without fix
+        memset(&snapshot.geo_data, 0, sizeof(tile_geo_data_t));
+    }
+
+    return pending ? TILE_TIMEOUT : TILE_SUCCESS;
+}
+
+tile_status_t SwarmTile::getPowerStatus(tile_power_t &power)
+{
+    tile_status_t result;
+
+    memset(&power, 0, sizeof(tile_power_t));
+    power.valid = false;
+
+    if (_power_rate > 0) {
+        // Tile sends status periodically, use latest message
+        _flushStream();
+        if (_power.valid && _isRecent(_power_ms, _power_rate)) {
+            power = _power;
+            return TILE_SUCCESS;
+        }
+    }
+
+    result = _sendCommand("$PW @");
     if (result != TILE_SUCCESS) {
         return result;
     }
 
-    if (_rx_field_count != 5) {
+    _power.valid = false;
+    _processPower();
+    if (!_power.valid) {
         return TILE_PROTOCOL_ERROR;
     }
+    power = _power;
 
-    // TODO: On SAMD M0 atof adds 11kb to executable! Reimplement?
-    geo_data.latitude = atof(_rx_fields[1]);
-    geo_data.longitude = atof(_rx_fields[2]);
-    geo_data.altitude = atof(_rx_fields[3]);
-    geo_data.course = atof(_rx_fields[4]);
-    geo_data.speed = atof(_rx_fields[5]);
-    
-    // todo: add sanity checks?
-    geo_data.valid = true;
+    return TILE_SUCCESS;
+}
+
+tile_status_t SwarmTile::getJammingStatus(tile_jamming_t &jamming)
+{
+    tile_status_t result;
+
+    memset(&jamming, 0, sizeof(tile_jamming_t));
+    jamming.valid = false;
+
+    if (_jamming_rate > 0) {
+        // Tile sends status periodically, use latest message
+        _flushStream();
+        if (_jamming.valid && _isRecent(_jamming_ms, _jamming_rate)) {
+            jamming = _jamming;
+            return TILE_SUCCESS;
+        }
+    }
+
+    result = _sendCommand("$GJ @");
+    if (result != TILE_SUCCESS) {
+        return result;
+    }
+
+    _jamming.valid = false;
+    _processJamming();
+    if (!_jamming.valid) {
+        return TILE_PROTOCOL_ERROR;
+    }
+    jamming = _jamming;
 
     return TILE_SUCCESS;
 }
 
+tile_status_t SwarmTile::setPowerStatusRate(uint32_t seconds)
+{
+    tile_status_t result;
+
+    result = _setRate("$PW", seconds);
+    if (result == TILE_SUCCESS) {
+        _power_rate = seconds;
+        _power.valid = false;
+    }
+
+    return result;
+}
+
+tile_status_t SwarmTile::setJammingStatusRate(uint32_t seconds)
+{
+    tile_status_t result;
+
+    result = _setRate("$GJ", seconds);
+    if (result == TILE_SUCCESS) {
+        _jamming_rate = seconds;
+        _jamming.valid = false;
+    }
+
+    return result;
+}
+
 tile_status_t SwarmTile::getUnsentCount(tile_msg_count_t &msg_count)
 {
     tile_status_t result;
@@ -295,14 +600,7 @@ tile_status_t SwarmTile::getUnsentCount(tile_msg_count_t &msg_count)
         return result;
     }
 
-    if (_rx_field_count != 1) {
-        return TILE_PROTOCOL_ERROR;
-    }
-
-    msg_count.count = _strToUInt(_rx_fields[1], strlen(_rx_fields[1]));
-    msg_count.valid = true;
-
-    return TILE_SUCCESS;
+    return _parseMsgCount(msg_count);
 }
 
 uint16_t SwarmTile::getUnsentCount()
@@ -330,14 +628,7 @@ tile_status_t SwarmTile::getUnreadCount(tile_msg_count_t &msg_count)
         return result;
     }
 
-    if (_rx_field_count != 1) {
-        return TILE_PROTOCOL_ERROR;
-    }
-
-    msg_count.count = _strToUInt(_rx_fields[1], strlen(_rx_fields[1]));
-    msg_count.valid = true;
-
-    return TILE_SUCCESS;
+    return _parseMsgCount(msg_count);
 }
 
 uint16_t SwarmTile::getUnreadCount()
@@ -365,14 +656,7 @@ tile_status_t SwarmTile::deleteUnsentMsgs(tile_msg_count_t &msg_count)
         return result;
     }
 
-    if (_rx_field_count != 1) {
-        return TILE_PROTOCOL_ERROR;
-    }
-
-    msg_count.count = _strToUInt(_rx_fields[1], strlen(_rx_fields[1]));
-    msg_count.valid = true;
-
-    return TILE_SUCCESS;
+    return _parseMsgCount(msg_count);
 }
 
 uint16_t SwarmTile::deleteUnsentMsgs()
@@ -400,14 +684,7 @@ tile_status_t SwarmTile::deleteReadMsgs(tile_msg_count_t &msg_count)
         return result;
     }
 
-    if (_rx_field_count != 1) {
-        return TILE_PROTOCOL_ERROR;
-    }
-
-    msg_count.count = _strToUInt(_rx_fields[1], strlen(_rx_fields[1]));
-    msg_count.valid = true;
-
-    return TILE_SUCCESS;
+    return _parseMsgCount(msg_count);
 }
 
 uint16_t SwarmTile::deleteReadMsgs()
@@ -426,69 +703,403 @@ uint16_t SwarmTile::deleteReadMsgs()
 tile_status_t SwarmTile::sendMessage(tile_send_msg_t &send_msg)
 {
     tile_status_t result;
-    char num_buf[16];
 
     send_msg.msg_id = 0;
     send_msg.valid = false;
+    send_msg.queued = false;
 
-    _sendBegin();
-    _send("$TD ");
-    if (send_msg.app_id != 0) {
-        // only supported with Tile FW v1.1.0+
-        // add version check?
-        _send("AI=");
-        _send(ltoa(send_msg.app_id, num_buf, 10));
-        _send(',');
-    }
-    if (send_msg.hold_time > 0) {
-        _send("HD=");
-        _send(ltoa(send_msg.hold_time, num_buf, 10));
-        _send(',');
-    } else if (send_msg.expiration.valid == true) {
-        _send("ET=");
-        _send(ultoa(_makeEpoch(send_msg.expiration), num_buf, 10));
-        _send(',');
-    }
-    if (send_msg.message) {
-        uint16_t i = 0;
-        while (i < send_msg.msg_len) {
-            _send(_hex[(send_msg.message[i] >> 4) & 0xf]);
-            _send(_hex[send_msg.message[i] & 0xf]);
-            i++;
+    if (_queue) {
+        _drainQueue();
+        if (_queue->count() > 0 || !_windowOpen()) {
+            // queue behind already queued messages, scheduler picks next message by priority
+            return _queueMessage(send_msg);
         }
     }
-    _sendEnd();
-
-    result = _receiveResponse("$TD");
 
+    result = _sendMessage(send_msg);
+    if (result == TILE_COMMAND_ERROR && _err_code == TILE_ERR_DBXTOHIVEFULL && _recoverDb()) {
+        // database was reinitialized, Tile has room again
+        result = _sendMessage(send_msg);
+    }
     if (result == TILE_SUCCESS) {
-        if (_rx_field_count == 2 && strcmp(_rx_fields[1], "OK") == 0) {
-            // ok
-            send_msg.msg_id = _strToUInt(_rx_fields[2], strlen(_rx_fields[2]));
-            send_msg.valid = true;
-            return TILE_SUCCESS;
-        } 
-    } 
+        _in_flight++;
+    }
+
+    if (_queue && result == TILE_COMMAND_ERROR && _err_code == TILE_ERR_DBXTOHIVEFULL) {
+        // Tile is full, hold message locally until Tile sent messages
+        _queue_ready = false;
+        _queue_full_ms = millis();
+        return _queueMessage(send_msg);
+    }
 
     return result;
 }
 
-tile_status_t SwarmTile::sendMessage(const char* str)
+void SwarmTile::setOverflowQueue(TileQueue *queue)
 {
-    tile_send_msg_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.message = str;
-    msg.msg_len = strlen(str);
-    return sendMessage(msg);
+    _queue = queue;
+    _queue_ready = true;
 }
 
-tile_status_t SwarmTile::sendMessage(const char* buf, uint16_t len)
+void SwarmTile::setSendWindow(uint8_t messages)
 {
-    tile_send_msg_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.message = buf;
-    msg.msg_len = len;
-    return sendMessage(msg);
+    _send_window = messages;
+    _in_flight = 0;
+    _in_flight_ms = millis();
+}
+
+// returns true if Tile can take another message within send window
+bool SwarmTile::_windowOpen()
+{
+    if (_send_window == 0 || _in_flight < _send_window) {
+        return true;
+    }
+
+    if (millis() - _in_flight_ms >= TILE_QUEUE_RETRY_MS) {
+        // messages may have expired on Tile without $TD SENT, verify count
+        tile_msg_count_t count;
+        _in_flight_ms = millis();
+        if (getUnsentCount(count) == TILE_SUCCESS) {
+            _in_flight = count.count;
+        }
+    }
+
+    return _in_flight < _send_window;
+}
+
+tile_status_t SwarmTile::_queueMessage(tile_send_msg_t &send_msg)
+{
+    if (!_queue->push(send_msg)) {
+        _setErrorStr("QUEUEFULL");
+        return TILE_COMMAND_ERROR;
+    }
+
+    _setErrorStr(0);
+    send_msg.queued = true;
+    return TILE_SUCCESS;
+}
+
+// hand queued messages to Tile until queue is empty or Tile is full
+void SwarmTile::_drainQueue()
+{
+    tile_send_msg_t msg;
+    char msg_buf[TILE_MAX_MSG_SIZE];
+    tile_status_t result;
+
+    if (_queue == 0 || _queue->count() == 0) {
+        return;
+    }
+
+    // pick up $TD SENT received since last command
+    _flushStream();
+
+    if (!_queue_ready && millis() - _queue_full_ms < TILE_QUEUE_RETRY_MS) {
+        // wait for Tile to send messages
+        return;
+    }
+
+    while (_windowOpen() && _queue->peek(msg, msg_buf, sizeof(msg_buf))) {
+        result = _sendMessage(msg);
+        if (result == TILE_SUCCESS) {
+            _queue->pop();
+            _in_flight++;
+        } else if (result == TILE_COMMAND_ERROR && _err_code == TILE_ERR_DBXTOHIVEFULL) {
+            if (_recoverDb()) {
+                // database was reinitialized, resubmit queued messages
+                continue;
+            }
+            // Tile is still full
+            _queue_ready = false;
+            _queue_full_ms = millis();
+            return;
+        } else if (result == TILE_COMMAND_ERROR) {
+            // Tile rejected message, e.g. expired
+            _queue->discard();
+        } else {
+            // communication error, try again later
+            _queue_full_ms = millis();
+            _queue_ready = false;
+            return;
+        }
+    }
+}
+
+void SwarmTile::setSendRetry(uint8_t retries, uint16_t backoff_ms)
+{
+    _send_retries = retries;
+    _retry_backoff_ms = backoff_ms;
+}
+
+// hand message to Tile, retrying when we can't tell whether Tile took it
+tile_status_t SwarmTile::_sendMessage(tile_send_msg_t &send_msg)
+{
+    tile_status_t result;
+    uint32_t backoff_ms = _retry_backoff_ms;
+    bool unknown;   // Tile may hold message from a previous attempt
+    bool listed = false;    // identical messages held before first attempt are known
+    uint64_t known[TILE_SEND_KNOWN_COUNT];
+    uint8_t known_count = 0;
+    uint8_t i, j, k;
+
+    if (_send_retries > 0) {
+        // identical messages the Tile already holds must not be taken for this one on retry,
+        // listed for every send as a retry can't be ruled out before the first attempt
+        result = _findUnsent(send_msg, known, TILE_SEND_KNOWN_COUNT, known_count);
+        listed = (result == TILE_SUCCESS && known_count <= TILE_SEND_KNOWN_COUNT);
+    }
+
+    result = _submitMessage(send_msg);
+    unknown = (result == TILE_TIMEOUT || result == TILE_PROTOCOL_ERROR);
+
+    for (i = 0; i < _send_retries && unknown && listed; i++) {
+        delay(backoff_ms);
+        backoff_ms *= 2;
+        if (backoff_ms > TILE_RETRY_BACKOFF_MAX_MS) {
+            backoff_ms = TILE_RETRY_BACKOFF_MAX_MS;
+        }
+
+        uint64_t found[TILE_SEND_KNOWN_COUNT + 1];
+        uint8_t found_count;
+        tile_status_t list_result = _findUnsent(send_msg, found, TILE_SEND_KNOWN_COUNT + 1, found_count);
+        if (list_result != TILE_SUCCESS || found_count > TILE_SEND_KNOWN_COUNT + 1) {
+            // still can't tell, resending could duplicate the message
+            continue;
+        }
+        uint64_t msg_id = 0;
+        for (j = 0; j < found_count && msg_id == 0; j++) {
+            msg_id = found[j];
+            for (k = 0; k < known_count; k++) {
+                if (known[k] == msg_id) {
+                    msg_id = 0;
+                    break;
+                }
+            }
+        }
+        if (msg_id != 0) {
+            // response got lost, Tile queued message
+            send_msg.msg_id = msg_id;
+            send_msg.valid = true;
+            _pending_msg_t &pending = _sent_pending.push();
+            pending.msg_id = msg_id;
+            pending.queued_ms = millis();
+            _db_full_count = 0;
+            _db_recovery_armed = true;
+            return TILE_SUCCESS;
+        }
+
+        result = _submitMessage(send_msg);
+        unknown = (result == TILE_TIMEOUT || result == TILE_PROTOCOL_ERROR);
+    }
+
+    return result;
+}
+
+// list Tile's unsent messages with the same app_id and content as send_msg
+// stores up to max msg_ids in ids, count is the number of identical messages and may exceed max
+tile_status_t SwarmTile::_findUnsent(const tile_send_msg_t &send_msg, uint64_t *ids, uint8_t max, uint8_t &count)
+{
+    tile_status_t result;
+
+    count = 0;
+
+    // Tile lists one message per line, followed by the count of unsent messages
+    result = _sendCommand("$MT L=U");
+    while (result == TILE_SUCCESS) {
+        if (_rx_field_count < 3) {
+            // end of list
+            return TILE_SUCCESS;
+        }
+        uint8_t f = 1;  // message field
+        uint16_t app_id = 0;
+        if (_fieldStartsWith(1, "AI=")) {
+            app_id = _fieldUInt(1, 3);
+            f++;
+        }
+        if (app_id == send_msg.app_id && _fieldHexEquals(f, send_msg.message, send_msg.msg_len)) {
+            if (count < max) {
+                ids[count] = _fieldUInt(f+1);
+            }
+            if (count < 0xff) {
+                count++;
+            }
+        }
+        result = _receiveResponse("$MT");
+    }
+
+    count = 0;
+    return result;
+}
+
+tile_status_t SwarmTile::_submitMessage(tile_send_msg_t &send_msg)
+{
+    tile_status_t result;
+    char num_buf[16];
+
+    send_msg.msg_id = 0;
+    send_msg.valid = false;
+
+    if (send_msg.app_id != 0 && !_assumeCapability(TILE_CAP_APP_ID)) {
+        // Tile would reject AI= field
+        _setErrorStr("BADAPPID");
+        return TILE_COMMAND_ERROR;
+    }
+
+    _sendBegin();
+    _send("$TD ");
+    if (send_msg.app_id != 0) {
+        _send("AI=");
+        _send(ltoa(send_msg.app_id, num_buf, 10));
+        _send(',');
+    }
+    if (send_msg.hold_time > 0) {
+        _send("HD=");
+        _send(ltoa(send_msg.hold_time, num_buf, 10));
+        _send(',');
+    } else if (send_msg.expiration.valid == true) {
+        _send("ET=");
+        _send(ultoa(_makeEpoch(send_msg.expiration), num_buf, 10));
+        _send(',');
+    }
+    if (send_msg.message) {
+        uint16_t i = 0;
+        while (i < send_msg.msg_len) {
+            _send(_hex[(send_msg.message[i] >> 4) & 0xf]);
+            _send(_hex[send_msg.message[i] & 0xf]);
+            i++;
+        }
+    }
+    _sendEnd();
+
+    result = _receiveResponse("$TD");
+
+    if (result == TILE_SUCCESS) {
+        if (_rx_field_count == 2 && _fieldEquals(1, "OK")) {
+            // ok
+            send_msg.msg_id = _fieldUInt(2);
+            send_msg.valid = true;
+            // remember when message was queued to measure latency until sent
+            _pending_msg_t &pending = _sent_pending.push();
+            pending.msg_id = send_msg.msg_id;
+            pending.queued_ms = millis();
+            _db_full_count = 0;
+            _db_recovery_armed = true;
+            return TILE_SUCCESS;
+        } 
+    } else if (result == TILE_COMMAND_ERROR && _err_code == TILE_ERR_DBXTOHIVEFULL) {
+        if (_db_full_count < 0xff) {
+            _db_full_count++;
+        }
+    }
+
+    return result;
+}
+
+void SwarmTile::setDbRecovery(uint8_t threshold)
+{
+    _db_threshold = threshold;
+    _db_full_count = 0;
+    _db_recovery_armed = true;
+}
+
+uint16_t SwarmTile::getDbRecoveryCount()
+{
+    return _db_recoveries;
+}
+
+// reinitialize Tile's message database when it keeps reporting DBXTOHIVEFULL
+// returns true if Tile rebooted with an empty database
+bool SwarmTile::_recoverDb()
+{
+    if (_db_threshold == 0 || _db_full_count < _db_threshold || !_db_recovery_armed) {
+        return false;
+    }
+
+    // only one attempt until Tile accepts a message again
+    _db_recovery_armed = false;
+
+    if (!_fwDbAffected()) {
+        // database is really full
+        _setErrorStr("DBXTOHIVEFULL");
+        return false;
+    }
+
+    if (_sendCommand("$RS dbinit") != TILE_SUCCESS || _waitBoot() != TILE_SUCCESS) {
+        _setErrorStr("DBXTOHIVEFULL");
+        return false;
+    }
+
+    // messages held by Tile are gone
+    _db_full_count = 0;
+    _db_recoveries++;
+    _queue_ready = true;
+    _in_flight = 0;
+    _sent_pending.clear();
+    _setErrorStr(0);
+
+    return true;
+}
+
+// returns true if firmware may report DBXTOHIVEFULL for a corrupted database
+bool SwarmTile::_fwDbAffected()
+{
+    tile_version_t version;
+
+    if (!_capabilities_valid) {
+        getVersion(version);
+    }
+    if (!_capabilities_valid) {
+        // unknown firmware version
+        return false;
+    }
+
+    return !(_capabilities & TILE_CAP_DB_FIXED);
+}
+
+// wait for $M138 BOOT,RUNNING after Tile restarted
+tile_status_t SwarmTile::_waitBoot()
+{
+    tile_status_t result;
+    unsigned long timeout_ms = _timeout_ms;
+
+    _timeout_ms = TILE_BOOT_TIMEOUT_MS;
+    TILE_TIMEOUT_START
+
+    while (1) {
+        result = _readLine();
+        if (result == TILE_TIMEOUT) {
+            break;
+        }
+        if (!_validLine() || _parseResponse() != TILE_SUCCESS || _rx_fields[1].ptr == 0) {
+            // ignore garbage while Tile reboots
+            continue;
+        }
+        if (_fieldEquals(0, "$M138") && _rx_field_count == 2 &&
+            _fieldEquals(1, "BOOT") && _fieldEquals(2, "RUNNING")) {
+            break;
+        }
+        _dispatchUnsolicited();
+    }
+
+    _timeout_ms = timeout_ms;
+    return result;
+}
+
+tile_status_t SwarmTile::sendMessage(const char* str)
+{
+    tile_send_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.message = str;
+    msg.msg_len = strlen(str);
+    return sendMessage(msg);
+}
+
+tile_status_t SwarmTile::sendMessage(const char* buf, uint16_t len)
+{
+    tile_send_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.message = buf;
+    msg.msg_len = len;
+    return sendMessage(msg);
 }
 
 tile_status_t SwarmTile::sendMessage(uint16_t app_id, const char* str)
@@ -539,22 +1150,14 @@ tile_status_t SwarmTile::readMessage(tile_read_msg_t &read_msg)
         if (_rx_field_count >= 3) {
             uint8_t f = 0;  // fields before message field
             // handle App ID field received with v1.1.0+
-            if (strncmp(_rx_fields[1], "AI=", 3) == 0) {
-                read_msg.app_id = _strToUInt(_rx_fields[1]+3, strlen(_rx_fields[1])-3);
+            if (_fieldStartsWith(1, "AI=")) {
+                read_msg.app_id = _fieldUInt(1, 3);
                 f += 1;
             }
             // unpack message
-            const char *hexstr = _rx_fields[f+1];
-            uint16_t i = 0;
-            uint16_t j = 0;
-            while (hexstr[i] != 0 && j < read_msg.msg_max) {
-                read_msg.message[j] = (_hexToInt(hexstr[i]) << 4) | _hexToInt(hexstr[i+1]);
-                i += 2;
-                j++;
-            }
-            read_msg.msg_len = j;
-            read_msg.msg_id = _strToUInt(_rx_fields[f+2], strlen(_rx_fields[f+2]));
-            _makeDatetime(read_msg.timestamp, _strToUInt(_rx_fields[f+3], strlen(_rx_fields[f+3])));
+            read_msg.msg_len = _fieldHexDecode(f+1, read_msg.message, read_msg.msg_max);
+            read_msg.msg_id = _fieldUInt(f+2);
+            _makeDatetime(read_msg.timestamp, _fieldUInt(f+3));
             read_msg.valid = true;
             return TILE_SUCCESS;
         }
@@ -579,66 +1182,353 @@ uint16_t SwarmTile::readMessage(char *buf, uint16_t buf_len, tile_order_t order)
     return 0;
 }
 
-void SwarmTile::setTimeout(uint16_t timeout_ms)
+bool SwarmTile::hasUnreadMessages()
+{
+    if (_gpio_mode == TILE_GPIO_MSG_PENDING_LOW || _gpio_mode == TILE_GPIO_MSG_PENDING_HIGH) {
+        // Tile signals pending messages on GPIO1, no need to ask over serial
+        if (!isGpioActive()) {
+            return false;
+        }
+    }
+
+    return getUnreadCount() > 0;
+}
+
+tile_status_t SwarmTile::poll()
+{
+    _flushStream();
+    _drainQueue();
+    return TILE_SUCCESS;
+}
+
+tile_status_t SwarmTile::setReceiveTestRate(uint32_t seconds)
+{
+    return _setRate("$RT", seconds);
+}
+
+void SwarmTile::getRssiStats(tile_rssi_stats_t &stats)
+{
+    memset(&stats, 0, sizeof(tile_rssi_stats_t));
+    stats.valid = false;
+
+    if (_rssi_window.count() == 0) {
+        return;
+    }
+
+    int16_t sum = 0;
+    stats.last = _rssi_window.newest();
+    stats.min = stats.last;
+    stats.max = stats.last;
+    for (uint8_t i = 0; i < _rssi_window.count(); i++) {
+        int8_t rssi = _rssi_window.newest(i);
+        if (rssi < stats.min) {
+            stats.min = rssi;
+        }
+        if (rssi > stats.max) {
+            stats.max = rssi;
+        }
+        sum += rssi;
+    }
+    stats.mean = sum / (int16_t) _rssi_window.count();
+    stats.samples = _rssi_window.count();
+    stats.total = _rssi_total;
+    stats.valid = true;
+}
+
+uint8_t SwarmTile::getSatPasses(tile_sat_pass_t *passes, uint8_t max_passes)
+{
+    uint8_t i = 0;
+    while (i < _sat_passes.count() && i < max_passes) {
+        passes[i] = _sat_passes.newest(i);
+        i++;
+    }
+    return i;
+}
+
+void SwarmTile::resetReceiveTestStats()
+{
+    _rssi_window.clear();
+    _rssi_total = 0;
+    _sat_passes.clear();
+    _sat_pass_last = 0;
+}
+
+void SwarmTile::getLinkStats(tile_link_stats_t &stats)
+{
+    stats = _link_stats;
+}
+
+uint8_t SwarmTile::getSentLog(tile_sent_record_t *records, uint8_t max_records)
+{
+    uint8_t i = 0;
+    while (i < _sent_log.count() && i < max_records) {
+        records[i] = _sent_log.newest(i);
+        i++;
+    }
+    return i;
+}
+
+void SwarmTile::getRxStats(tile_rx_stats_t &stats)
+{
+    stats = _rx_stats;
+}
+
+void SwarmTile::resetRxStats()
+{
+    memset(&_rx_stats, 0, sizeof(_rx_stats));
+}
+
+void SwarmTile::resetLinkStats()
+{
+    _sent_pending.clear();
+    _sent_log.clear();
+    memset(&_link_stats, 0, sizeof(_link_stats));
+    _link_stats.valid = false;
+    _latency_sum = 0;
+    _rssi_sum = 0;
+    _snr_sum = 0;
+}
+
+void SwarmTile::setTimeout(uint16_t timeout_ms)
+{
+    _timeout_ms = timeout_ms;
+}
+
+void SwarmTile::setDebugStream(Stream *debug, tile_debug_format_t format)
+{
+    _debug = debug;
+    _debug_format = format;
+    _trace_dir = 0;
+}
+
+void SwarmTile::setWaitHook(tile_wait_hook_t hook, void *context)
+{
+    _wait_hook = hook;
+    _wait_context = context;
+}
+
+void SwarmTile::setUnsolicitedHook(tile_unsolicited_hook_t hook, void *context)
+{
+    _unsolicited_hook = hook;
+    _unsolicited_context = context;
+}
+
+const char* SwarmTile::getErrorStr()
+{
+    return _err_str;
+}
+
+tile_error_t SwarmTile::getError()
+{
+    return _err_code;
+}
+
+void SwarmTile::_setErrorStr(const char* str)
+{
+    memset(_err_str, 0, sizeof(_err_str));
+    _err_code = TILE_ERR_NONE;
+    if (str) {
+        strncpy(_err_str, str, sizeof(_err_str)-1);
+        _err_code = _lookupError(_err_str);
+    }
+}
+
+void SwarmTile::_flushStream()
+{
+    // process complete unsolicited messages, keep partial line for next read
+    while (_receiveChars()) {
+        _processUnsolicited();
+    }
+}
+
+// move available characters from stream into line buffer
+// returns true once a line is complete, oversized lines are dropped
+bool SwarmTile::_receiveChars()
+{
+    char ch;
+
+    if (_rx_line_done) {
+        // previous line was consumed, start a new one
+        _rx_buf_pos = 0;
+        _rx_line_done = false;
+        _rx_buffer[0] = 0;
+        memset(_rx_fields, 0, sizeof(_rx_fields));
+        _rx_field_count = 0;
+    }
+
+    while (_stream.available()) {
+        ch = _stream.read();
+        if (_debug) {
+            _debugWrite('R', ch);
+        }
+        if (ch == '\n') {
+            if (_rx_skip) {
+                // end of oversized line
+                _rx_skip = false;
+                continue;
+            }
+            if (_rx_buf_pos == 0) {
+                // nothing but noise
+                continue;
+            }
+            // line is complete, exit
+            _rx_line_done = true;
+            _rx_stats.lines++;
+            return true;
+        }
+        if (_rx_skip) {
+            continue;
+        }
+        if (ch == '$') {
+            if (_rx_buf_pos > 0) {
+                // next sentence started before end of line, drop partial line
+                _rx_stats.corrupted++;
+                _rx_buf_pos = 0;
+            }
+        } else if (_rx_buf_pos == 0) {
+            // skip to start of next sentence
+            _rx_stats.noise++;
+            continue;
+        }
+        if (_rx_buf_pos < sizeof(_rx_buffer) - 1) {
+            // store character in line buffer
+            _rx_buffer[_rx_buf_pos] = ch;
+            _rx_buf_pos++;
+            _rx_buffer[_rx_buf_pos] = 0;
+        } else {
+            // line is too long, discard it up to next newline
+            _rx_stats.overflows++;
+            _rx_buf_pos = 0;
+            _rx_buffer[0] = 0;
+            _rx_skip = true;
+        }
+    }
+
+    return false;
+}
+
+// returns TILE_SUCCESS with a complete line or TILE_TIMEOUT
+tile_status_t SwarmTile::_readLine()
+{
+    while (1) {
+        TILE_TIMEOUT_CHECK
+        if (_receiveChars()) {
+            return TILE_SUCCESS;
+        }
+        if (_wait_hook) {
+            // sleep until more characters arrive instead of spinning on available(),
+            // also at elapsed == timeout, TILE_TIMEOUT_CHECK only expires after that
+            unsigned long elapsed = millis() - _timeout_start;
+            if (elapsed <= _timeout_ms) {
+                _wait_hook(_wait_context, _timeout_ms - elapsed);
+            }
+        }
+    }
+}
+
+// parsers for responses in rx fields, shared by single queries and getStatusSnapshot
+
+tile_status_t SwarmTile::_parseVersion(tile_version_t &version)
+{
+    if (_rx_field_count != 2) {
+        return TILE_PROTOCOL_ERROR;
+    }
+
+    _fieldCopy(1, version.date_str, sizeof(version.date_str));
+    _fieldCopy(2, version.version_str, sizeof(version.version_str));
+
+    // v<major>.<minor>.<patch>
+    const char *v = version.version_str;
+    if (*v == 'v') {
+        v++;
+    }
+    if (isdigit(*v)) {
+        version.major = atoi(v);
+        v = strchr(v, '.');
+        if (v) {
+            version.minor = atoi(++v);
+            v = strchr(v, '.');
+            if (v) {
+                version.patch = atoi(++v);
+            }
+        }
+        _setCapabilities(version);
+    }
+    version.valid = true;
+
+    return TILE_SUCCESS;
+}
+
+tile_status_t SwarmTile::_parseDateTime(tile_datetime_t &datetime)
 {
-    _timeout_ms = timeout_ms;
-}
+    if (_rx_field_count != 2 || _rx_fields[1].len != 14) {
+        return TILE_PROTOCOL_ERROR;
+    }
 
-void SwarmTile::setDebugStream(Stream *debug)
-{
-    _debug = debug;
-}
+    // yyyymmddhhmmss
+    const char *dt = _rx_fields[1].ptr;
+    datetime.year = _strToUInt(dt, 4);
+    datetime.month = _strToUInt(dt+4, 2);
+    datetime.day = _strToUInt(dt+6, 2);
+    datetime.hour = _strToUInt(dt+8, 2);
+    datetime.minute = _strToUInt(dt+10, 2);
+    datetime.second = _strToUInt(dt+12, 2);
 
-const char* SwarmTile::getErrorStr()
-{
-    return _err_str;
+    if (_fieldStartsWith(2, "V")) {
+        datetime.valid = true;
+        if (_queue) {
+            // lets the queue schedule messages by expiration time
+            _queue->setTime(_makeEpoch(datetime));
+        }
+    }
+
+    return TILE_SUCCESS;   
 }
 
-void SwarmTile::_setErrorStr(const char* str)
+// $GS <hdop>,<vdop>,<gnss_sats>,<unused>,<fix>
+tile_status_t SwarmTile::_parseGeoFix()
 {
-    memset(_err_str, 0, sizeof(_err_str));
-    if (str) {
-        strncpy(_err_str, str, sizeof(_err_str)-1);
+    if (_rx_field_count != 5) {
+        return TILE_PROTOCOL_ERROR;
+    }
+
+    if (_fieldEquals(5, "NF")) {
+        return TILE_NO_GPS_FIX;
     }
+
+    return TILE_SUCCESS;
 }
 
-void SwarmTile::_flushStream()
+// $GN <lat>,<lon>,<alt>,<course>,<speed>
+tile_status_t SwarmTile::_parseGeoData(tile_geo_data_t &geo_data)
 {
-    // discard any unsolicited data
-    while (_stream.available()) {
-        _stream.read();
+    if (_rx_field_count != 5) {
+        return TILE_PROTOCOL_ERROR;
     }
+
+    // TODO: On SAMD M0 atof adds 11kb to executable! Reimplement?
+    geo_data.latitude = _fieldFloat(1);
+    geo_data.longitude = _fieldFloat(2);
+    geo_data.altitude = _fieldFloat(3);
+    geo_data.course = _fieldFloat(4);
+    geo_data.speed = _fieldFloat(5);
+    
+    // todo: add sanity checks?
+    geo_data.valid = true;
+
+    return TILE_SUCCESS;
 }
 
-tile_status_t SwarmTile::_readLine()
+tile_status_t SwarmTile::_parseMsgCount(tile_msg_count_t &msg_count)
 {
-    char ch;
+    if (_rx_field_count != 1) {
+        return TILE_PROTOCOL_ERROR;
+    }
 
-    _rx_buf_pos = 0;
-    memset(_rx_buffer, 0, sizeof(_rx_buffer));
-    memset(_rx_fields, 0, sizeof(_rx_fields));
+    msg_count.count = _fieldUInt(1);
+    msg_count.valid = true;
 
-    while (1) {
-        TILE_TIMEOUT_CHECK
-        while (_stream.available()) {
-            ch = _stream.read();
-            if (_debug) {
-                _debug->write(ch);
-            }
-            if (ch == '\n') {
-                // line is complete, exit
-                return TILE_SUCCESS;
-            }
-            if (_rx_buf_pos < sizeof(_rx_buffer) - 1) {
-                // store character in line buffer
-                _rx_buffer[_rx_buf_pos] = ch;
-                _rx_buf_pos++;
-            } else {
-                // line is too long
-                return TILE_RX_OVERFLOW;
-            }
-        }
-    }
+    return TILE_SUCCESS;
 }
 
 tile_status_t SwarmTile::_sendCommand(const char *command, bool response)
@@ -659,9 +1549,46 @@ tile_status_t SwarmTile::_sendCommand(const char *command, bool response)
     return _receiveResponse(command);
 }
 
+// set rate of periodic message, Tile confirms with OK
+tile_status_t SwarmTile::_setRate(const char *command, uint32_t seconds)
+{
+    tile_status_t result;
+    char rate_buf[12];
+    unsigned long timeout_ms = _timeout_ms;
+    unsigned long start = millis();
+
+    _flushStream();
+
+    _sendBegin();
+    _send(command);
+    _send(' ');
+    _send(ultoa(seconds, rate_buf, 10));
+    _sendEnd();
+
+    // one timeout for all lines, periodic messages must not keep the command waiting
+    while (1) {
+        unsigned long elapsed = millis() - start;
+        if (elapsed >= timeout_ms) {
+            result = TILE_TIMEOUT;
+            break;
+        }
+        _timeout_ms = timeout_ms - elapsed;
+        result = _receiveResponse(command);
+        if (result != TILE_SUCCESS || _fieldEquals(1, "OK")) {
+            break;
+        }
+        // periodic message sent before response
+        _dispatchUnsolicited();
+    }
+
+    _timeout_ms = timeout_ms;
+    return result;
+}
+
 tile_status_t SwarmTile::_receiveResponse(const char *command)
 {
     tile_status_t result;
+    bool corrupted = false;     // seen a corrupted response
     _setErrorStr(0);
 
     TILE_TIMEOUT_START
@@ -670,17 +1597,20 @@ tile_status_t SwarmTile::_receiveResponse(const char *command)
     while (1) {
         result = _readLine();        
         if (result != TILE_SUCCESS) {
-            // will eventually return with timeout
-            return result;
+            // a garbled response tells more than a timeout
+            return corrupted ? TILE_PROTOCOL_ERROR : result;
         }
-        if (strncmp(_rx_buffer, command, 3) == 0) {
-            break;
+        if (!_isResponse(command)) {
+            _processUnsolicited();
+            continue;
         }
-    }
-
-    // check that response is a valid NMEA sentence, including checksum
-    if (!_nmeaValidate(_rx_buffer, _rx_buf_pos)) {
-        return TILE_PROTOCOL_ERROR;
+        // check that response is a valid NMEA sentence, including checksum
+        if (!_validLine()) {
+            // keep waiting, Tile won't repeat response but a later line may still match
+            corrupted = true;
+            continue;
+        }
+        break;
     }
 
     // extract fields from response
@@ -690,14 +1620,17 @@ tile_status_t SwarmTile::_receiveResponse(const char *command)
     }
 
     // check that response has at least 1 field
-    if (_rx_fields[1] == 0) {
+    if (_rx_fields[1].ptr == 0) {
         return TILE_PROTOCOL_ERROR;
     }
 
     // check that response isn't indicating an error
-    if (strncmp("ERR", _rx_fields[1], 3) == 0) {
+    if (_fieldEquals(1, "ERR")) {
         if (_rx_field_count >= 2) {
-            _setErrorStr(_rx_fields[2]);
+            _fieldCopy(2, _err_str, sizeof(_err_str));
+            _err_code = _lookupError(_err_str);
+        } else {
+            _err_code = TILE_ERR_UNKNOWN;
         }
         return TILE_COMMAND_ERROR;
     }
@@ -710,49 +1643,460 @@ tile_status_t SwarmTile::_parseResponse()
     // assumptions:
     // - valid NMEA sentence, including * at end of last field
     // - cmd field1,..,fieldn*crc without extra spaces
+    // fields are recorded as start and length, receive buffer isn't modified
     uint16_t i = 0; // character index
     uint8_t f = 0;  // field index
     bool cmd = true;  // still parsing cmd
+    bool key = false; // current field is key=value
     _rx_field_count = 0;
     memset(_rx_fields, 0, sizeof(_rx_fields));
-    _rx_fields[0] = _rx_buffer;
+    memset(_rx_keys, -1, sizeof(_rx_keys));
+    _rx_fields[0].ptr = _rx_buffer;
     while (i < _rx_buf_pos) {
-        if (_rx_buffer[i] == '*') {
+        char ch = _rx_buffer[i];
+        if (ch == '*') {
             // found end of last field
-            _rx_buffer[i] = 0;
             break;
         }
-        if (cmd) {
-            if (_rx_buffer[i] == ' ') {
-                // found end of command, start of first field
-                _rx_buffer[i] = 0;
-                cmd = false;
-                f = 1;
-                i++;
-                _rx_fields[f] = _rx_buffer + i;
-            } else {
-                i++;
+        if (cmd && ch == ' ') {
+            // found end of command, start of first field
+            cmd = false;
+            f = 1;
+            _rx_fields[f].ptr = _rx_buffer + i + 1;
+        } else if (!cmd && ch == ',') {
+            // found end of current field, start of next field
+            if (key) {
+                _indexKey(f);
+                key = false;
             }
+            if (f + 1 >= TILE_NMEA_FIELD_COUNT) {
+                // exceeding supported field count, ignore remaining fields
+                break;
+            }
+            f++;
+            _rx_fields[f].ptr = _rx_buffer + i + 1;
         } else {
-            if (_rx_buffer[i] == ',') {
-                // found end of current field, start of next field
-                _rx_buffer[i] = 0;
-                f++;
-                if (f >= TILE_NMEA_FIELD_COUNT) {
-                    // exceeding supported field count, ignore remaining fields
-                    return TILE_PROTOCOL_ERROR;
-                }
-                i++;
-                _rx_fields[f] = _rx_buffer + i;
-            } else {
-                i++;
+            if (!cmd && ch == '=') {
+                key = true;
             }
+            _rx_fields[f].len++;
         }
+        i++;
+    }
+    if (key) {
+        _indexKey(f);
     }
     _rx_field_count = f;
     return TILE_SUCCESS;
 }
 
+// add key=value field f to key index
+void SwarmTile::_indexKey(uint8_t f)
+{
+    uint16_t len = 0;
+    while (len < _rx_fields[f].len && _rx_fields[f].ptr[len] != '=') {
+        len++;
+    }
+
+    // linear probing, index has more slots than fields
+    uint8_t slot = _keyHash(_rx_fields[f].ptr, len);
+    while (_rx_keys[slot] >= 0) {
+        slot = (slot + 1) % TILE_KEY_SLOTS;
+    }
+    _rx_keys[slot] = f;
+}
+
+// field accessors, fields beyond _rx_field_count are empty
+
+// returns true if field f is exactly str
+bool SwarmTile::_fieldEquals(uint8_t f, const char *str)
+{
+    if (f > _rx_field_count) {
+        return false;
+    }
+    return strlen(str) == _rx_fields[f].len && memcmp(_rx_fields[f].ptr, str, _rx_fields[f].len) == 0;
+}
+
+bool SwarmTile::_fieldStartsWith(uint8_t f, const char *prefix)
+{
+    uint16_t len = strlen(prefix);
+    if (f > _rx_field_count || _rx_fields[f].len < len) {
+        return false;
+    }
+    return memcmp(_rx_fields[f].ptr, prefix, len) == 0;
+}
+
+bool SwarmTile::_fieldIsNumber(uint8_t f)
+{
+    return f <= _rx_field_count && _rx_fields[f].len > 0 && isdigit(_rx_fields[f].ptr[0]);
+}
+
+// returns index of first <key>=<value> field, -1 if missing
+int8_t SwarmTile::_fieldKey(const char *key)
+{
+    uint16_t len = strlen(key);
+    uint8_t slot = _keyHash(key, len);
+    while (_rx_keys[slot] >= 0) {
+        uint8_t f = _rx_keys[slot];
+        if (_rx_fields[f].len > len && _rx_fields[f].ptr[len] == '=' &&
+            memcmp(_rx_fields[f].ptr, key, len) == 0) {
+            return f;
+        }
+        slot = (slot + 1) % TILE_KEY_SLOTS;
+    }
+    return -1;
+}
+
+// decimal or 0x prefixed hex number, skip is the number of characters to skip, e.g. of key=
+uint64_t SwarmTile::_fieldUInt(uint8_t f, uint8_t skip)
+{
+    if (f > _rx_field_count || _rx_fields[f].len <= skip) {
+        return 0;
+    }
+    return _strToUInt(_rx_fields[f].ptr + skip, _rx_fields[f].len - skip);
+}
+
+int32_t SwarmTile::_fieldInt(uint8_t f, uint8_t skip)
+{
+    if (f > _rx_field_count || _rx_fields[f].len <= skip) {
+        return 0;
+    }
+    return _strToInt(_rx_fields[f].ptr + skip, _rx_fields[f].len - skip);
+}
+
+float SwarmTile::_fieldFloat(uint8_t f)
+{
+    if (f > _rx_field_count || _rx_fields[f].len == 0) {
+        return 0;
+    }
+    // atof stops at the ',' or '*' following the field
+    return atof(_rx_fields[f].ptr);
+}
+
+// copies field as NUL terminated string, returns length copied
+uint16_t SwarmTile::_fieldCopy(uint8_t f, char *buf, uint16_t buf_len, uint8_t skip)
+{
+    uint16_t len = 0;
+    if (f <= _rx_field_count && _rx_fields[f].len > skip) {
+        len = _rx_fields[f].len - skip;
+        if (len > buf_len - 1) {
+            len = buf_len - 1;
+        }
+        memcpy(buf, _rx_fields[f].ptr + skip, len);
+    }
+    buf[len] = 0;
+    return len;
+}
+
+// decodes hex encoded field into buf, returns number of bytes
+uint16_t SwarmTile::_fieldHexDecode(uint8_t f, char *buf, uint16_t buf_len)
+{
+    uint16_t i = 0;
+    uint16_t j = 0;
+    if (f > _rx_field_count) {
+        return 0;
+    }
+    const char *hex = _rx_fields[f].ptr;
+    while (i + 1 < _rx_fields[f].len && j < buf_len) {
+        buf[j] = (_hexToInt(hex[i]) << 4) | _hexToInt(hex[i+1]);
+        i += 2;
+        j++;
+    }
+    return j;
+}
+
+// returns true if hex encoded field f holds the len bytes in buf
+bool SwarmTile::_fieldHexEquals(uint8_t f, const char *buf, uint16_t len)
+{
+    uint16_t i;
+    if (f > _rx_field_count || _rx_fields[f].len != len * 2) {
+        return false;
+    }
+    const char *hex = _rx_fields[f].ptr;
+    for (i = 0; i < len; i++) {
+        if ((char) ((_hexToInt(hex[2*i]) << 4) | _hexToInt(hex[2*i+1])) != buf[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// returns true if line in rx buffer is a valid NMEA sentence, counts corrupted lines
+bool SwarmTile::_validLine()
+{
+    if (!_nmeaValidate(_rx_buffer, _rx_buf_pos)) {
+        _rx_stats.corrupted++;
+        return false;
+    }
+    return true;
+}
+
+// returns true if line in rx buffer may answer command, e.g. $MT ... for "$MT C=U"
+bool SwarmTile::_isResponse(const char *command)
+{
+    uint16_t i = 0;
+    while (command[i] != 0 && command[i] != ' ') {
+        if (i >= _rx_buf_pos || _rx_buffer[i] != command[i]) {
+            return false;
+        }
+        i++;
+    }
+    // command must match exactly, e.g. $M138 doesn't answer $M
+    if (i < _rx_buf_pos && _rx_buffer[i] != ' ' && _rx_buffer[i] != '*') {
+        return false;
+    }
+    return !_isUnsolicited();
+}
+
+// returns true if line in rx buffer is an unsolicited message that never answers a command
+bool SwarmTile::_isUnsolicited()
+{
+    if (strncmp(_rx_buffer, "$RT RSSI=", 9) == 0) {
+        // receive test output, responses to $RT commands are OK, ERR or the rate
+        return true;
+    }
+    if (strncmp(_rx_buffer, "$TD SENT ", 9) == 0) {
+        // message was sent, responses to $TD commands are OK or ERR
+        return true;
+    }
+    return false;
+}
+
+void SwarmTile::_processUnsolicited()
+{
+    if (!_validLine()) {
+        // ignore corrupted or partial lines
+        return;
+    }
+
+    if (_parseResponse() != TILE_SUCCESS || _rx_fields[1].ptr == 0) {
+        return;
+    }
+
+    _dispatchUnsolicited();
+}
+
+// process parsed unsolicited message
+void SwarmTile::_dispatchUnsolicited()
+{
+    if (_fieldEquals(0, "$PW")) {
+        _processPower();
+    } else if (_fieldEquals(0, "$GJ")) {
+        _processJamming();
+    } else if (_fieldEquals(0, "$RT")) {
+        _processReceiveTest();
+    } else if (_fieldEquals(0, "$TD") && _fieldStartsWith(1, "SENT ")) {
+        _processSent();
+    }
+
+    if (_unsolicited_hook) {
+        tile_response_t response;
+        memcpy(response.fields, _rx_fields, sizeof(response.fields));
+        response.field_count = _rx_field_count;
+        response.valid = true;
+        _unsolicited_hook(_unsolicited_context, response);
+    }
+}
+
+void SwarmTile::_processPower()
+{
+    // $PW <cpu_volts>,<unused>,<unused>,<unused>,<temp>
+    if (_rx_field_count != 5 || !_fieldIsNumber(1)) {
+        return;
+    }
+
+    _power.cpu_volts = _fieldFloat(1);
+    _power.temperature = _fieldFloat(5);
+    _power.valid = true;
+    _power_ms = millis();
+}
+
+void SwarmTile::_processJamming()
+{
+    // $GJ <spoof_state>,<jamming_level>
+    if (_rx_field_count != 2 || !_fieldIsNumber(1)) {
+        return;
+    }
+
+    _jamming.spoof_state = (tile_spoof_state_t) _fieldUInt(1);
+    _jamming.jamming_level = _fieldUInt(2);
+    _jamming.valid = true;
+    _jamming_ms = millis();
+}
+
+// periodic message received within the last TILE_STATUS_MAX_PERIODS periods of rate seconds
+bool SwarmTile::_isRecent(unsigned long received_ms, uint32_t rate)
+{
+    return (uint64_t) (millis() - received_ms) <= (uint64_t) rate * 1000 * TILE_STATUS_MAX_PERIODS;
+}
+
+void SwarmTile::_processReceiveTest()
+{
+    // background: $RT RSSI=<rssi>
+    // satellite:  $RT RSSI=<rssi>,SNR=<snr>,FDEV=<fdev>,TS=<yyyy-mm-dd hh:mm:ss>,DI=<sat_id>
+    int16_t rssi = 0;
+    int16_t snr = 0;
+    int16_t fdev = 0;
+    uint32_t sat_id = 0;
+    tile_datetime_t ts;
+    int8_t f;
+
+    memset(&ts, 0, sizeof(ts));
+
+    if ((f = _fieldKey("RSSI")) < 0) {
+        return;
+    }
+    rssi = _fieldInt(f, 5);
+    if ((f = _fieldKey("SNR")) >= 0) {
+        snr = _fieldInt(f, 4);
+    }
+    if ((f = _fieldKey("FDEV")) >= 0) {
+        fdev = _fieldInt(f, 5);
+    }
+    if ((f = _fieldKey("TS")) >= 0 && _rx_fields[f].len == 22) {
+        const char *dt = _rx_fields[f].ptr;
+        ts.year = _strToUInt(dt+3, 4);
+        ts.month = _strToUInt(dt+8, 2);
+        ts.day = _strToUInt(dt+11, 2);
+        ts.hour = _strToUInt(dt+14, 2);
+        ts.minute = _strToUInt(dt+17, 2);
+        ts.second = _strToUInt(dt+20, 2);
+        ts.valid = true;
+    }
+
+    if ((f = _fieldKey("DI")) < 0) {
+        // background noise sample
+        if (rssi < -128) {
+            rssi = -128;
+        } else if (rssi > 127) {
+            rssi = 127;
+        }
+        _rssi_window.push((int8_t) rssi);
+        _rssi_total++;
+        return;
+    }
+    sat_id = _fieldUInt(f, 3);
+
+    // satellite packet, extend current pass or start a new one
+    time_t epoch = _makeEpoch(ts);
+    tile_sat_pass_t *pass = 0;
+    if (_sat_passes.count() > 0) {
+        pass = &_sat_passes.newest();
+        if (pass->sat_id != sat_id || epoch - _sat_pass_last > TILE_SAT_PASS_GAP_S) {
+            pass = 0;
+        }
+    }
+    if (pass == 0) {
+        pass = &_sat_passes.push();
+        memset(pass, 0, sizeof(tile_sat_pass_t));
+        pass->sat_id = sat_id;
+        pass->start = ts;
+        pass->rssi_max = rssi;
+        pass->snr_max = snr;
+    }
+    pass->end = ts;
+    pass->packets++;
+    if (rssi > pass->rssi_max) {
+        pass->rssi_max = rssi;
+    }
+    if (snr > pass->snr_max) {
+        pass->snr_max = snr;
+    }
+    pass->fdev = fdev;
+    _sat_pass_last = epoch;
+}
+
+void SwarmTile::_processSent()
+{
+    // $TD SENT RSSI=<rssi>,SNR=<snr>,FDEV=<fdev>,<msg_id>
+    tile_sent_record_t record;
+    int8_t f;
+    uint8_t i;
+
+    memset(&record, 0, sizeof(record));
+    record.latency = TILE_LATENCY_UNKNOWN;
+
+    // RSSI shares the first field with SENT, field is left as received for the unsolicited hook
+    if (_fieldStartsWith(1, "SENT RSSI=")) {
+        record.rssi = _fieldInt(1, 10);
+    }
+    if ((f = _fieldKey("SNR")) >= 0) {
+        record.snr = _fieldInt(f, 4);
+    }
+    if ((f = _fieldKey("FDEV")) >= 0) {
+        record.fdev = _fieldInt(f, 5);
+    }
+
+    // message ID is the last field
+    if (!_fieldIsNumber(_rx_field_count)) {
+        return;
+    }
+    record.msg_id = _fieldUInt(_rx_field_count);
+
+    // Tile has room for queued messages
+    _queue_ready = true;
+    if (_in_flight > 0) {
+        _in_flight--;
+    }
+
+    // look up when message was queued
+    for (i = 0; i < _sent_pending.count(); i++) {
+        _pending_msg_t &pending = _sent_pending.newest(i);
+        if (pending.msg_id == record.msg_id) {
+            record.latency = (millis() - pending.queued_ms) / 1000;
+            pending.msg_id = 0;
+            break;
+        }
+    }
+
+    _sent_log.push(record);
+
+    tile_link_stats_t &stats = _link_stats;
+    if (stats.sent == 0) {
+        stats.rssi_min = record.rssi;
+        stats.rssi_max = record.rssi;
+        stats.snr_min = record.snr;
+        stats.snr_max = record.snr;
+    }
+    stats.sent++;
+    if (record.rssi < stats.rssi_min) {
+        stats.rssi_min = record.rssi;
+    }
+    if (record.rssi > stats.rssi_max) {
+        stats.rssi_max = record.rssi;
+    }
+    if (record.snr < stats.snr_min) {
+        stats.snr_min = record.snr;
+    }
+    if (record.snr > stats.snr_max) {
+        stats.snr_max = record.snr;
+    }
+    _rssi_sum += record.rssi;
+    _snr_sum += record.snr;
+    stats.rssi_mean = _rssi_sum / (int32_t) stats.sent;
+    stats.snr_mean = _snr_sum / (int32_t) stats.sent;
+
+    if (record.latency != TILE_LATENCY_UNKNOWN) {
+        if (stats.tracked == 0 || record.latency < stats.latency_min) {
+            stats.latency_min = record.latency;
+        }
+        if (record.latency > stats.latency_max) {
+            stats.latency_max = record.latency;
+        }
+        stats.tracked++;
+        _latency_sum += record.latency;
+        stats.latency_mean = _latency_sum / stats.tracked;
+
+        uint8_t b = 0;
+        while (b < TILE_LATENCY_BUCKETS-1 && record.latency >= _latency_buckets[b]) {
+            b++;
+        }
+        stats.latency_hist[b]++;
+    }
+
+    stats.valid = true;
+}
+
 void SwarmTile::_sendBegin()
 {
     _tx_pos = 0;
@@ -769,7 +2113,7 @@ void SwarmTile::_send(char c)
     }
     _stream.write(c);
     if (_debug) {
-        _debug->write(c);
+        _debugWrite('T', c);
     }
     _tx_pos++;
 }
@@ -791,11 +2135,49 @@ void SwarmTile::_sendEnd()
     _stream.flush();
 
     if (_debug) {
-        _debug->write('*');
-        _debug->write(_hex[(_tx_checksum >> 4) & 0x0f]);
-        _debug->write(_hex[_tx_checksum & 0x0f]);
+        _debugWrite('T', '*');
+        _debugWrite('T', _hex[(_tx_checksum >> 4) & 0x0f]);
+        _debugWrite('T', _hex[_tx_checksum & 0x0f]);
+        _debugWrite('T', '\n');
+        _debug->flush();
+    }
+}
+
+// trace lines start with millis() and direction, non-printable bytes and \ are escaped as \xhh
+// and a \ at the end marks a line continued in a later trace line
+void SwarmTile::_debugWrite(char dir, char c)
+{
+    if (_debug_format == TILE_DEBUG_RAW) {
+        _debug->write(c);
+        return;
+    }
+
+    if (_trace_dir != dir) {
+        char num_buf[12];
+        if (_trace_dir != 0) {
+            // other direction interrupted line
+            _debug->write('\\');
+            _debug->write('\n');
+        }
+        _debug->write(ultoa(millis(), num_buf, 10));
+        _debug->write(' ');
+        _debug->write(dir);
+        _debug->write(' ');
+        _trace_dir = dir;
+    }
+
+    if (c == '\n') {
+        // a capture ended by a signal or power loss keeps all complete lines
         _debug->write('\n');
         _debug->flush();
+        _trace_dir = 0;
+    } else if (c < ' ' || c > '~' || c == '\\') {
+        _debug->write('\\');
+        _debug->write('x');
+        _debug->write(_hex[((uint8_t) c >> 4) & 0x0f]);
+        _debug->write(_hex[c & 0x0f]);
+    } else {
+        _debug->write(c);
     }
 }
 
@@ -831,10 +2213,60 @@ static bool _nmeaValidate(const char *msg, size_t len)
     return true;
 }
 
-/*
+// error strings and codes, sorted by string for binary search
+static const struct {
+    const char *str;
+    tile_error_t code;
+} _errors[] = {
+    { "BADAPPID", TILE_ERR_BADAPPID },
+    { "BADDATA", TILE_ERR_BADDATA },
+    { "BADEXPIRETIME", TILE_ERR_BADEXPIRETIME },
+    { "BADGPIOMODE", TILE_ERR_BADGPIOMODE },
+    { "BADHOLDTIME", TILE_ERR_BADHOLDTIME },
+    { "BADPARAM", TILE_ERR_BADPARAM },
+    { "DBXINVMSGID", TILE_ERR_DBXINVMSGID },
+    { "DBXNOMORE", TILE_ERR_DBXNOMORE },
+    { "DBXTOHIVEFULL", TILE_ERR_DBXTOHIVEFULL },
+    { "NOCOMMAND", TILE_ERR_NOCOMMAND },
+    { "NOREADBUFFER", TILE_ERR_NOREADBUFFER },
+    { "NOSPACE", TILE_ERR_NOSPACE },
+    { "NOTIME", TILE_ERR_NOTIME },
+    { "NOTSLEEPING", TILE_ERR_NOTSLEEPING },
+    { "QUEUEFULL", TILE_ERR_QUEUEFULL },
+};
+
+static tile_error_t _lookupError(const char* str)
+{
+    int8_t lo = 0;
+    int8_t hi = sizeof(_errors) / sizeof(_errors[0]) - 1;
+    while (lo <= hi) {
+        int8_t mid = (lo + hi) / 2;
+        int cmp = strcmp(str, _errors[mid].str);
+        if (cmp == 0) {
+            return _errors[mid].code;
+        } else if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return TILE_ERR_UNKNOWN;
+}
+
+static uint8_t _keyHash(const char* key, size_t len)
+{
+    uint16_t hash = 0;
+    while (len > 0) {
+        hash = hash * 31 + (uint8_t) *key;
+        key++;
+        len--;
+    }
+    return hash % TILE_KEY_SLOTS;
+}
+
 static int32_t _strToInt(const char* str, size_t len)
 {
-    int val = 0;
+    int32_t val = 0;
     bool neg = false;
     if (*str == '-') {
         // handle negative numbers
@@ -852,7 +2284,6 @@ static int32_t _strToInt(const char* str, size_t len)
     }
     return val;
 }
-*/
 
 static uint64_t _strToUInt(const char* str, size_t len)
 {
@@ -881,21 +2312,17 @@ static uint64_t _strToUInt(const char* str, size_t len)
 }
 
 // convert datetime stucture to UTC epoch
-// assumes that input is in UTC
-static time_t _makeEpoch(tile_datetime_t &datetime)
+// assumes that input is in UTC, counts days directly as mktime() would apply the local time zone
+static time_t _makeEpoch(const tile_datetime_t &datetime)
 {
     if (datetime.valid != true) {
         return 0;
     }
-    struct tm t;
-    t.tm_year = datetime.year - 1900;
-    t.tm_mon = datetime.month - 1;
-    t.tm_mday = datetime.day;
-    t.tm_hour = datetime.hour;
-    t.tm_min = datetime.minute;
-    t.tm_sec = datetime.second;
-    t.tm_isdst = 0;
-    return mktime(&t) - _timezone;
+    // days since 1970-01-01, with March as first month of year to put leap days last
+    int32_t y = datetime.year - (datetime.month <= 2);
+    uint32_t m = datetime.month > 2 ? datetime.month - 3 : datetime.month + 9;
+    int32_t days = y * 365 + y / 4 - y / 100 + y / 400 + (153 * m + 2) / 5 + datetime.day - 1 - 719468;
+    return (time_t) days * 86400 + datetime.hour * 3600L + datetime.minute * 60 + datetime.second;
 }
 
 // convert UTC epoch to datetime structure
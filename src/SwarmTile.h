@@ -5,6 +5,7 @@
 #include "Arduino.h"
 #include <Stream.h>
 #include <time.h>
+#include "TileRing.h"
 
 #ifndef TILE_MAX_MSG_SIZE
 // max message size for Swarm is 192 bytes
@@ -14,37 +15,148 @@
 
 #ifndef TILE_RX_BUFFER_SIZE
 // buffer size for one line of incoming serial data
-// adding 40 bytes for overhead in $RD and $TD
-#define TILE_RX_BUFFER_SIZE 40 + (TILE_MAX_MSG_SIZE * 2)
+// adding 56 bytes for overhead in $MM, i.e. app ID, 20 digit msg_id, epoch and checksum
+#define TILE_RX_BUFFER_SIZE (56 + (TILE_MAX_MSG_SIZE * 2))
 #endif
 
 // default timeout for communication with Tile
 // note: getUnsentCount is very slow, to real-world testing before reducing timeout!
 #define TILE_TIMEOUT_MS 2000
-// max number of fields in a serial message, incl. command
+#ifndef TILE_NMEA_FIELD_COUNT
+// max number of fields in a serial message, incl. command, further fields are ignored
+// increase for firmware with wider responses
 #define TILE_NMEA_FIELD_COUNT 8
+#endif
+// slots of key=value index, more slots than fields keep lookups short
+#define TILE_KEY_SLOTS (TILE_NMEA_FIELD_COUNT * 2)
+// marker for no MCU pin attached to Tile GPIO1
+#define TILE_GPIO_NO_PIN 0xff
+
+#ifndef TILE_RSSI_WINDOW
+// number of background RSSI samples from $RT kept for statistics
+#define TILE_RSSI_WINDOW 32
+#endif
+
+#ifndef TILE_SAT_PASS_COUNT
+// number of satellite passes from $RT kept in pass log
+#define TILE_SAT_PASS_COUNT 4
+#endif
+
+// packets from the same satellite less than this many seconds apart belong to the same pass
+#define TILE_SAT_PASS_GAP_S 600
+
+#ifndef TILE_SENT_TRACK_COUNT
+// number of queued messages tracked to measure latency until $TD SENT
+#define TILE_SENT_TRACK_COUNT 16
+#endif
+
+#ifndef TILE_SENT_LOG_COUNT
+// number of $TD SENT confirmations kept in sent log
+#define TILE_SENT_LOG_COUNT 8
+#endif
+
+// retry handing queued messages to Tile after this time even without $TD SENT
+#define TILE_QUEUE_RETRY_MS 60000
+
+// first wait before retrying $TD after a timeout, doubles with every retry
+#ifndef TILE_RETRY_BACKOFF_MS
+#define TILE_RETRY_BACKOFF_MS 500
+#endif
+// upper bound of wait between retries
+#define TILE_RETRY_BACKOFF_MAX_MS 8000
+
+#ifndef TILE_SEND_KNOWN_COUNT
+// identical unsent messages remembered before a send that may be retried, more disable the retry
+#define TILE_SEND_KNOWN_COUNT 4
+#endif
+
+// periodic status is used until it is this many rate periods old, e.g. after Tile rebooted
+#define TILE_STATUS_MAX_PERIODS 2
+
+// max time for Tile to reboot after reinitializing its message database
+#ifndef TILE_BOOT_TIMEOUT_MS
+#define TILE_BOOT_TIMEOUT_MS 30000
+#endif
+
+// latency histogram buckets: <1m, <5m, <15m, <1h, <4h, <12h, <24h, 24h+
+#define TILE_LATENCY_BUCKETS 8
+// latency of a sent message that wasn't queued through this library instance
+#define TILE_LATENCY_UNKNOWN 0xffffffff
 
 typedef enum {
     TILE_SUCCESS = 0,
     TILE_TIMEOUT = 1,
     TILE_PROTOCOL_ERROR = 2,
     TILE_COMMAND_ERROR = 3,
-    TILE_RX_OVERFLOW = 4,
+    TILE_RX_OVERFLOW = 4,       // unused, oversized lines are dropped and counted in tile_rx_stats_t
     TILE_NO_GPS_FIX = 5
 } tile_status_t;
 
+// error reported with TILE_COMMAND_ERROR, see getError()
+typedef enum {
+    TILE_ERR_NONE = 0,          // no error
+    TILE_ERR_UNKNOWN,           // error not known to library, see getErrorStr()
+    TILE_ERR_BADAPPID,          // invalid app id
+    TILE_ERR_BADDATA,           // message data isn't valid hex or too long
+    TILE_ERR_BADEXPIRETIME,     // expiration time is invalid or in the past
+    TILE_ERR_BADHOLDTIME,       // hold time is out of range
+    TILE_ERR_BADPARAM,          // invalid command parameter
+    TILE_ERR_DBXINVMSGID,       // message id not found in database
+    TILE_ERR_DBXNOMORE,         // no more messages in database
+    TILE_ERR_DBXTOHIVEFULL,     // outbound message database is full
+    TILE_ERR_NOCOMMAND,         // command not recognized by Tile
+    TILE_ERR_NOSPACE,           // no space for message
+    TILE_ERR_NOTIME,            // Tile hasn't acquired date/time yet
+    // errors generated by the library
+    TILE_ERR_BADGPIOMODE,       // GPIO mode doesn't signal events
+    TILE_ERR_NOREADBUFFER,      // no buffer provided to read message into
+    TILE_ERR_NOTSLEEPING,       // Tile wasn't sleeping when calling wake()
+    TILE_ERR_QUEUEFULL          // Tile and local overflow queue are full
+} tile_error_t;
+
+// suggested priority classes for tile_send_msg_t.priority, any value 0-255 can be used
+typedef enum {
+    TILE_PRIORITY_BULK = 0,     // bulk data, can wait
+    TILE_PRIORITY_NORMAL = 64,  // regular telemetry
+    TILE_PRIORITY_HIGH = 128,   // important events
+    TILE_PRIORITY_ALARM = 255   // alarms, jump ahead of everything else
+} tile_priority_t;
+
 typedef enum {
     TILE_OLDEST = 0,
     TILE_NEWEST = 1
 } tile_order_t;
 
+typedef enum {
+    TILE_GPIO_ANALOG = 0,               // pin disconnected and not used (default)
+    TILE_GPIO_WAKE_RISING = 1,          // input, low-to-high transition exits sleep mode
+    TILE_GPIO_WAKE_FALLING = 2,         // input, high-to-low transition exits sleep mode
+    TILE_GPIO_OUTPUT_LOW = 3,           // output, set low
+    TILE_GPIO_OUTPUT_HIGH = 4,          // output, set high
+    TILE_GPIO_MSG_PENDING_LOW = 5,      // output, low indicates received messages pending for client
+    TILE_GPIO_MSG_PENDING_HIGH = 6,     // output, high indicates received messages pending for client
+    TILE_GPIO_TRANSMIT_LOW = 7,         // output, low while transmitting, otherwise high
+    TILE_GPIO_TRANSMIT_HIGH = 8,        // output, high while transmitting, otherwise low
+    TILE_GPIO_SLEEP_LOW = 9,            // output, low indicates sleep mode, otherwise high
+    TILE_GPIO_SLEEP_HIGH = 10           // output, high indicates sleep mode, otherwise low
+} tile_gpio_mode_t;
+
 typedef struct {
     // output
     char date_str[20];      // firmware date and time as a string, e.g. 2021-03-23-18:25:40
     char version_str[20];   // firmeare version as a string, e.g. v1.0.0
+    uint8_t major;          // numeric version, e.g. 1.0.0, all 0 if version_str can't be parsed
+    uint8_t minor;
+    uint8_t patch;
     bool valid;
 } tile_version_t;
 
+// firmware features, see SwarmTile::hasCapability
+typedef enum {
+    TILE_CAP_APP_ID = 0x01,         // application ID on $TD and $MM, FW v1.1.0+
+    TILE_CAP_DB_FIXED = 0x02        // no false DBXTOHIVEFULL from corrupted database, FW v1.1.0+
+} tile_capability_t;
+
 typedef struct {
     // input/output
     uint16_t year;          // date and time in UTC
@@ -72,6 +184,29 @@ typedef struct {
     bool valid;
 } tile_msg_count_t;
 
+typedef struct {
+    // output, check valid flag of each member
+    tile_datetime_t datetime;   // $DT, valid if Tile has valid date/time
+    tile_msg_count_t unsent;    // $MT C=U
+    tile_msg_count_t unread;    // $MM C=U
+    tile_geo_data_t geo_data;   // $GN, valid if Tile has a GPS fix
+    tile_version_t version;     // $FV
+    bool gps_fix;               // $GS reported a fix
+} tile_status_snapshot_t;
+
+// field of a response, points into receive buffer without NUL termination, valid until next call into library
+typedef struct {
+    const char *ptr;
+    uint16_t len;
+} tile_field_t;
+
+typedef struct {
+    // output
+    tile_field_t fields[TILE_NMEA_FIELD_COUNT]; // fields[0] is the command, e.g. $RT
+    uint8_t field_count;    // number of fields after command
+    bool valid;
+} tile_response_t;
+
 typedef struct {
     // input
     const char *message;    // pointer to message to be sent
@@ -79,9 +214,11 @@ typedef struct {
     uint16_t app_id;        // app id to send with message, set to 0 if not used or if Tile FW is pre v1.1.0
     uint32_t hold_time;     // time in seconds before unsent msg is discarded (60-172800), set to 0 if not used
     tile_datetime_t expiration; // UTC time when unsent msgs is discarded, ignored if epxiration.valid != true or hold_time > 0
+    uint8_t priority;       // priority in local queue, higher is more important, see tile_priority_t
     // output
-    uint64_t msg_id;        // message id assigned by tile
+    uint64_t msg_id;        // message id assigned by tile, 0 if queued locally
     bool valid;
+    bool queued;            // true if message was held in local overflow queue
 } tile_send_msg_t;
 
 typedef struct {
@@ -113,6 +250,95 @@ typedef struct {
     bool valid;
 } tile_config_t;
 
+typedef struct {
+    // output
+    float cpu_volts;        // supply voltage measured by Tile CPU in volts
+    float temperature;      // Tile CPU temperature in degrees Celsius
+    bool valid;
+} tile_power_t;
+
+typedef enum {
+    TILE_SPOOF_UNKNOWN = 0,     // spoofing state unknown or feature disabled
+    TILE_SPOOF_NONE = 1,        // no spoofing indicated
+    TILE_SPOOF_INDICATED = 2,   // spoofing indicated
+    TILE_SPOOF_MULTIPLE = 3     // multiple spoofing indications
+} tile_spoof_state_t;
+
+typedef struct {
+    // output
+    tile_spoof_state_t spoof_state;
+    uint8_t jamming_level;  // 0 (no jamming) to 255 (strong jamming)
+    bool valid;
+} tile_jamming_t;
+
+typedef struct {
+    // output
+    int16_t last;           // most recent background RSSI in dBm
+    int16_t min;            // lowest background RSSI in window in dBm
+    int16_t max;            // highest background RSSI in window in dBm
+    int16_t mean;           // mean background RSSI in window in dBm
+    uint8_t samples;        // number of samples in window (TILE_RSSI_WINDOW max)
+    uint32_t total;         // number of samples received since last reset
+    bool valid;             // false if no samples were received yet
+} tile_rssi_stats_t;
+
+typedef struct {
+    // output
+    uint32_t sat_id;        // ID of satellite
+    tile_datetime_t start;  // UTC time of first packet received during pass
+    tile_datetime_t end;    // UTC time of last packet received during pass
+    uint16_t packets;       // number of packets received during pass
+    int16_t rssi_max;       // best satellite RSSI during pass in dBm
+    int16_t snr_max;        // best signal to noise ratio during pass in dB
+    int16_t fdev;           // frequency deviation of last packet in Hz
+} tile_sat_pass_t;
+
+typedef struct {
+    // output
+    uint64_t msg_id;        // id of the sent message
+    uint32_t latency;       // seconds from sendMessage until sent, TILE_LATENCY_UNKNOWN if not tracked
+    int16_t rssi;           // satellite RSSI when sent in dBm
+    int16_t snr;            // signal to noise ratio when sent in dB
+    int16_t fdev;           // frequency deviation when sent in Hz
+} tile_sent_record_t;
+
+typedef struct {
+    // output
+    uint32_t sent;          // number of $TD SENT confirmations since last reset
+    uint32_t tracked;       // number of those with known latency
+    uint32_t latency_min;   // latency in seconds of tracked messages
+    uint32_t latency_mean;
+    uint32_t latency_max;
+    uint16_t latency_hist[TILE_LATENCY_BUCKETS];    // <1m, <5m, <15m, <1h, <4h, <12h, <24h, 24h+
+    int16_t rssi_min;       // satellite RSSI when sent in dBm
+    int16_t rssi_mean;
+    int16_t rssi_max;
+    int16_t snr_min;        // signal to noise ratio when sent in dB
+    int16_t snr_mean;
+    int16_t snr_max;
+    bool valid;             // false if no message was sent yet
+} tile_link_stats_t;
+
+typedef struct {
+    // output
+    uint32_t lines;         // complete lines received
+    uint32_t corrupted;     // lines discarded for bad checksum or cut short by next sentence
+    uint32_t overflows;     // lines discarded for exceeding TILE_RX_BUFFER_SIZE
+    uint32_t noise;         // bytes discarded outside of sentences
+} tile_rx_stats_t;
+
+typedef enum {
+    TILE_DEBUG_RAW = 0,     // bytes exactly as sent and received
+    TILE_DEBUG_TRACE = 1    // one line per sentence: "<millis> T|R <sentence>", see SwarmTile::setDebugStream
+} tile_debug_format_t;
+
+// blocks for up to timeout_ms or until the stream has data, see SwarmTile::setWaitHook
+typedef void (*tile_wait_hook_t)(void *context, uint32_t timeout_ms);
+// receives every valid unsolicited message, e.g. $TD SENT, see SwarmTile::setUnsolicitedHook
+typedef void (*tile_unsolicited_hook_t)(void *context, const tile_response_t &response);
+
+class TileQueue;
+
 class SwarmTile
 {
 public:
@@ -120,18 +346,33 @@ public:
 
     tile_status_t begin();
     void setTimeout(uint16_t timeout_ms);   // timeout in milliseconds, ~65 seconds max should suffice
-    void setDebugStream(Stream *debug);     // stream for debug output
+    void setDebugStream(Stream *debug, tile_debug_format_t format = TILE_DEBUG_RAW);   // stream for debug output
+    // called while waiting for a response instead of polling the stream, set to 0 to poll
+    void setWaitHook(tile_wait_hook_t hook, void *context = 0);
+    // called for unsolicited messages after the library processed them, set to 0 to disable
+    void setUnsolicitedHook(tile_unsolicited_hook_t hook, void *context = 0);
 
     bool isReady();         // returns true when Tile is ready (boot complete)
     bool isReadyToSend();   // returns true when Tile is ready to send messages (acquired date/time)
 
     const char* getErrorStr();  // returns error string in case of a TILE_COMMAND_ERROR
+    tile_error_t getError();    // returns error code in case of a TILE_COMMAND_ERROR
 
     tile_status_t getVersion(tile_version_t &version);
     tile_status_t getConfig(tile_config_t &config);
+    // firmware capabilities, queries $FV once and caches result until begin()
+    bool hasCapability(tile_capability_t capability);
     tile_status_t setGpioMode(uint8_t mode);
+    tile_status_t setGpioMode(tile_gpio_mode_t mode);
+    tile_status_t getGpioMode(tile_gpio_mode_t &mode);
     tile_status_t getDateTime(tile_datetime_t &datetime);
+    static uint32_t makeEpoch(const tile_datetime_t &datetime);    // UTC epoch of datetime, 0 if not valid
     tile_status_t getGeoData(tile_geo_data_t &geo_data);
+    // date/time, message counts, geo data and version in one pipelined exchange
+    // returns TILE_TIMEOUT if some responses are missing, members received are still valid
+    tile_status_t getStatusSnapshot(tile_status_snapshot_t &snapshot);
+    tile_status_t getPowerStatus(tile_power_t &power);
+    tile_status_t getJammingStatus(tile_jamming_t &jamming);
     tile_status_t getUnsentCount(tile_msg_count_t &msg_count);
     tile_status_t getUnreadCount(tile_msg_count_t &msg_count);
     tile_status_t deleteUnsentMsgs(tile_msg_count_t &msg_count);
@@ -142,6 +383,51 @@ public:
     tile_status_t wake();
     tile_status_t powerOff();
 
+    // send any command, e.g. "$RT @", and return fields of the response without copying them
+    tile_status_t command(const char *cmd, tile_response_t &response);
+
+    // hardware signalling through Tile GPIO1, pin is the MCU pin wired to GPIO1
+    // isr is attached to pin and fires when GPIO1 becomes active, set to 0 if not used
+    tile_status_t attachGpioPin(uint8_t pin, tile_gpio_mode_t mode, void (*isr)(void) = 0);
+    void detachGpioPin();
+    bool isGpioActive();        // returns true if GPIO1 signals the configured event
+
+    // process unsolicited messages from Tile, call regularly when using rates or receive test
+    tile_status_t poll();
+
+    // periodic status messages, getters return the latest message instead of asking Tile when rate > 0
+    tile_status_t setPowerStatusRate(uint32_t seconds);     // seconds between $PW messages, 0 to disable
+    tile_status_t setJammingStatusRate(uint32_t seconds);   // seconds between $GJ messages, 0 to disable
+
+    // receive test ($RT), Tile reports background RSSI and satellite packets at the given rate
+    tile_status_t setReceiveTestRate(uint32_t seconds);     // seconds between reports, 0 to disable
+    void getRssiStats(tile_rssi_stats_t &stats);            // background RSSI over last TILE_RSSI_WINDOW samples
+    uint8_t getSatPasses(tile_sat_pass_t *passes, uint8_t max_passes);  // copies pass log, newest first
+    void resetReceiveTestStats();
+
+    // link quality of sent messages, collected from $TD SENT confirmations
+    void getLinkStats(tile_link_stats_t &stats);
+    uint8_t getSentLog(tile_sent_record_t *records, uint8_t max_records);   // copies sent log, newest first
+    void resetLinkStats();
+
+    // serial receive statistics, discarded lines and noise indicate a bad connection
+    void getRxStats(tile_rx_stats_t &stats);
+    void resetRxStats();
+
+    // local queue for messages while Tile's outbound database is full, set to 0 to disable
+    void setOverflowQueue(TileQueue *queue);
+    // max messages handed to Tile at a time, others wait in local queue by priority and deadline
+    // requires overflow queue, set to 0 to hand messages to Tile until it is full
+    void setSendWindow(uint8_t messages);
+    // reinitialize Tile's message database after threshold consecutive DBXTOHIVEFULL errors,
+    // only on firmware before v1.1.0, messages held by Tile are lost, set to 0 to disable
+    void setDbRecovery(uint8_t threshold);
+    uint16_t getDbRecoveryCount();      // number of database reinitializations
+    // retry $TD up to retries times after a timeout or corrupted response, set to 0 to disable
+    // unsent messages are listed with $MT L=U before every send and again before each retry, so a message
+    // Tile already accepted isn't sent twice, each listing takes longer the more messages Tile holds
+    void setSendRetry(uint8_t retries, uint16_t backoff_ms = TILE_RETRY_BACKOFF_MS);
+
     // simplified API, hides complexity but also some error conditions
     uint16_t getUnsentCount();
     uint16_t getUnreadCount();
@@ -152,10 +438,17 @@ public:
     tile_status_t sendMessage(uint16_t app_id, const char* str);     // requires FW v1.1.0+    
     tile_status_t sendMessage(uint16_t app_id, const char* buf, uint16_t len);   // requires FW v1.1.0+
     uint16_t readMessage(char* buf, uint16_t buf_len, tile_order_t = TILE_OLDEST);
+    bool hasUnreadMessages();   // uses GPIO1 if attached in a TILE_GPIO_MSG_PENDING mode, else asks Tile
 
 private:
     Stream &_stream;    // serial stream of Tile
     Stream *_debug;     // stream for debug output
+    tile_debug_format_t _debug_format;
+    char _trace_dir;    // direction of unfinished trace line, 0 at start of line
+    tile_wait_hook_t _wait_hook;
+    void *_wait_context;
+    tile_unsolicited_hook_t _unsolicited_hook;
+    void *_unsolicited_context;
 
     // timeout variables unsigned long to match Arduino millis() return type
     unsigned long _timeout_ms;        // timeout for tile operations in milliseconds
@@ -164,13 +457,67 @@ private:
     // buffer for serial communication with tile, shared rx/tx to minimize RAM use
     char _rx_buffer[TILE_RX_BUFFER_SIZE];
     uint16_t _rx_buf_pos;
+    bool _rx_line_done;     // buffer holds a complete line, reset before receiving more
+    bool _rx_skip;          // discarding rest of an oversized line
+    tile_rx_stats_t _rx_stats;
 
     // NMEA fields in incoming message after parsing, pointers into rx/tx buffer
-    const char *_rx_fields[TILE_NMEA_FIELD_COUNT];
+    tile_field_t _rx_fields[TILE_NMEA_FIELD_COUNT];   // views into _rx_buffer, set by _parseResponse
+    int8_t _rx_keys[TILE_KEY_SLOTS];    // hash index of key=value fields, -1 for empty slot
     uint16_t _rx_field_count;
 
-    // copy of error message in case of TILE_COMMAND_ERROR
+    // copy of error message and matching code in case of TILE_COMMAND_ERROR
     char _err_str[20];
+    tile_error_t _err_code;
+
+    // MCU pin wired to Tile GPIO1, TILE_GPIO_NO_PIN if not attached
+    uint8_t _gpio_pin;
+    tile_gpio_mode_t _gpio_mode;
+    void (*_gpio_isr)(void);
+
+    // latest status from periodic messages
+    tile_power_t _power;
+    tile_jamming_t _jamming;
+    uint32_t _power_rate;
+    uint32_t _jamming_rate;
+    unsigned long _power_ms;        // millis() when _power was received
+    unsigned long _jamming_ms;      // millis() when _jamming was received
+
+    // local overflow queue
+    TileQueue *_queue;
+    bool _queue_ready;              // Tile sent a message, try to hand over queued messages
+    unsigned long _queue_full_ms;   // millis() when Tile last reported full database
+    uint8_t _send_window;           // max messages handed to Tile at a time, 0 for no limit
+    uint16_t _in_flight;            // messages handed to Tile and not confirmed as sent yet
+    unsigned long _in_flight_ms;    // millis() when _in_flight was last verified with Tile
+    uint8_t _db_threshold;          // consecutive DBXTOHIVEFULL errors before database recovery
+    uint8_t _db_full_count;         // consecutive DBXTOHIVEFULL errors
+    bool _db_recovery_armed;        // false after recovery until Tile accepted a message
+    uint16_t _db_recoveries;        // number of database reinitializations
+    uint8_t _capabilities;          // tile_capability_t bits of connected firmware
+    bool _capabilities_valid;       // false until firmware version is known
+    uint8_t _send_retries;          // retries of $TD after timeout or corrupted response
+    uint16_t _retry_backoff_ms;     // wait before first retry
+
+    // statistics collected from receive test output
+    TileRing<int8_t, TILE_RSSI_WINDOW> _rssi_window;
+    uint32_t _rssi_total;
+    TileRing<tile_sat_pass_t, TILE_SAT_PASS_COUNT> _sat_passes;
+    time_t _sat_pass_last;  // UTC epoch of last packet of newest pass
+
+    // messages queued with Tile and waiting for $TD SENT
+    typedef struct {
+        uint64_t msg_id;
+        unsigned long queued_ms;    // millis() when queued
+    } _pending_msg_t;
+    TileRing<_pending_msg_t, TILE_SENT_TRACK_COUNT> _sent_pending;
+
+    // statistics collected from $TD SENT
+    TileRing<tile_sent_record_t, TILE_SENT_LOG_COUNT> _sent_log;
+    tile_link_stats_t _link_stats;
+    uint64_t _latency_sum;
+    int32_t _rssi_sum;
+    int32_t _snr_sum;
 
     // rolling checksum of current command sent to tile
     uint8_t _tx_checksum;
@@ -181,14 +528,58 @@ private:
     void _send(char c);
     void _send(const char *str);
     void _sendEnd();
+    void _debugWrite(char dir, char c);
 
     void _flushStream();
+    bool _receiveChars();
     tile_status_t _readLine();
     tile_status_t _sendCommand(const char *command, bool response = true);
     tile_status_t _receiveResponse(const char *command);
+    tile_status_t _parseVersion(tile_version_t &version);
+    tile_status_t _parseDateTime(tile_datetime_t &datetime);
+    tile_status_t _parseGeoFix();
+    tile_status_t _parseGeoData(tile_geo_data_t &geo_data);
+    tile_status_t _parseMsgCount(tile_msg_count_t &msg_count);
     tile_status_t _parseResponse();
+    bool _validLine();
+    bool _isResponse(const char *command);
+    void _indexKey(uint8_t f);
+    bool _fieldEquals(uint8_t f, const char *str);
+    bool _fieldStartsWith(uint8_t f, const char *prefix);
+    bool _fieldIsNumber(uint8_t f);
+    int8_t _fieldKey(const char *key);
+    uint64_t _fieldUInt(uint8_t f, uint8_t skip = 0);
+    int32_t _fieldInt(uint8_t f, uint8_t skip = 0);
+    float _fieldFloat(uint8_t f);
+    uint16_t _fieldCopy(uint8_t f, char *buf, uint16_t buf_len, uint8_t skip = 0);
+    uint16_t _fieldHexDecode(uint8_t f, char *buf, uint16_t buf_len);
+    bool _fieldHexEquals(uint8_t f, const char *buf, uint16_t len);
+
+    tile_status_t _setRate(const char *command, uint32_t seconds);
+    bool _isUnsolicited();
+    void _processUnsolicited();
+    void _dispatchUnsolicited();
+    void _processPower();
+    void _processJamming();
+    bool _isRecent(unsigned long received_ms, uint32_t rate);
+    void _processReceiveTest();
+    void _processSent();
+
+    tile_status_t _sendMessage(tile_send_msg_t &send_msg);
+    tile_status_t _submitMessage(tile_send_msg_t &send_msg);
+    tile_status_t _findUnsent(const tile_send_msg_t &send_msg, uint64_t *ids, uint8_t max, uint8_t &count);
+    tile_status_t _queueMessage(tile_send_msg_t &send_msg);
+    void _drainQueue();
+    bool _windowOpen();
+    bool _recoverDb();
+    bool _fwDbAffected();
+    void _setCapabilities(const tile_version_t &version);
+    bool _assumeCapability(tile_capability_t capability);
+    tile_status_t _waitBoot();
 
     void _setErrorStr(const char* str);
 };
 
+#include "TileQueue.h"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,263 @@
+
+#include "TileQueue.h"
+
+// Tile accepts hold times between 60 and 172800 seconds
+#define TILE_HOLD_TIME_MIN 60
+
+TileRamStorage::TileRamStorage(void *buffer, uint32_t size)
+{
+    _buffer = (uint8_t*) buffer;
+    _size = size;
+}
+
+uint32_t TileRamStorage::size()
+{
+    return _size;
+}
+
+void TileRamStorage::read(uint32_t addr, void *buf, uint16_t len)
+{
+    memcpy(buf, _buffer + addr, len);
+}
+
+void TileRamStorage::write(uint32_t addr, const void *buf, uint16_t len)
+{
+    memmove(_buffer + addr, buf, len);
+}
+
+TileQueue::TileQueue(TileQueueStorage &storage, tile_drop_policy_t policy) : _storage(storage)
+{
+    _policy = policy;
+    _time_epoch = 0;
+    _time_ms = 0;
+    clear();
+    resetStats();
+}
+
+bool TileQueue::push(const tile_send_msg_t &msg)
+{
+    _header_t hdr;
+    uint32_t len = sizeof(hdr) + msg.msg_len;
+
+    if (msg.msg_len > TILE_MAX_MSG_SIZE || !_makeRoom(len, msg.priority)) {
+        _stats.rejected++;
+        return false;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_len = msg.msg_len;
+    hdr.app_id = msg.app_id;
+    hdr.priority = msg.priority;
+    hdr.hold_time = msg.hold_time;
+    hdr.expiration = msg.expiration;
+    hdr.queued_ms = millis();
+
+    _storage.write(_used, &hdr, sizeof(hdr));
+    if (msg.msg_len > 0) {
+        _storage.write(_used + sizeof(hdr), msg.message, msg.msg_len);
+    }
+    _used += len;
+    _count++;
+    _stats.queued++;
+
+    return true;
+}
+
+// select next message to hand to Tile
+// highest priority first, then earliest deadline (remaining hold time), then oldest
+bool TileQueue::peek(tile_send_msg_t &msg, char *buf, uint16_t buf_len)
+{
+    _header_t hdr;
+    uint32_t addr = 0;
+    bool found = false;
+    uint8_t best_priority = 0;
+    uint32_t best_remaining = 0;
+    uint32_t best_addr = 0;
+
+    _peek_valid = false;
+
+    while (addr < _used) {
+        _storage.read(addr, &hdr, sizeof(hdr));
+
+        uint32_t remaining = TILE_NO_DEADLINE;
+        if (hdr.hold_time > 0) {
+            // time spent in queue counts against hold time
+            uint32_t waited = ((uint32_t) millis() - hdr.queued_ms) / 1000;
+            if (waited >= hdr.hold_time || hdr.hold_time - waited < TILE_HOLD_TIME_MIN) {
+                // expired while queued, Tile can't hold it for less than the minimum
+                _remove(addr);
+                _stats.dropped++;
+                continue;
+            }
+            remaining = hdr.hold_time - waited;
+        } else if (hdr.expiration.valid && _time_epoch > 0) {
+            uint32_t now = _time_epoch + ((uint32_t) millis() - _time_ms) / 1000;
+            uint32_t expires = SwarmTile::makeEpoch(hdr.expiration);
+            if (expires <= now) {
+                // expired while queued
+                _remove(addr);
+                _stats.dropped++;
+                continue;
+            }
+            remaining = expires - now;
+        }
+
+        if (!found || hdr.priority > best_priority ||
+            (hdr.priority == best_priority && remaining < best_remaining)) {
+            found = true;
+            best_priority = hdr.priority;
+            best_remaining = remaining;
+            best_addr = addr;
+        }
+
+        addr += sizeof(hdr) + hdr.msg_len;
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    _storage.read(best_addr, &hdr, sizeof(hdr));
+    if (hdr.msg_len > buf_len) {
+        // message doesn't fit into buffer
+        return false;
+    }
+
+    memset(&msg, 0, sizeof(tile_send_msg_t));
+    _storage.read(best_addr + sizeof(hdr), buf, hdr.msg_len);
+    msg.message = buf;
+    msg.msg_len = hdr.msg_len;
+    msg.app_id = hdr.app_id;
+    msg.priority = hdr.priority;
+    msg.expiration = hdr.expiration;
+    if (hdr.hold_time > 0) {
+        // hand remaining hold time to Tile
+        msg.hold_time = best_remaining;
+    }
+
+    _peek_addr = best_addr;
+    _peek_valid = true;
+    return true;
+}
+
+void TileQueue::pop()
+{
+    if (_peek_valid) {
+        _remove(_peek_addr);
+        _stats.submitted++;
+        _peek_valid = false;
+    }
+}
+
+void TileQueue::discard()
+{
+    if (_peek_valid) {
+        _remove(_peek_addr);
+        _stats.dropped++;
+        _peek_valid = false;
+    }
+}
+
+void TileQueue::clear()
+{
+    _used = 0;
+    _count = 0;
+    _peek_addr = 0;
+    _peek_valid = false;
+}
+
+void TileQueue::setTime(uint32_t epoch)
+{
+    _time_epoch = epoch;
+    _time_ms = millis();
+}
+
+uint16_t TileQueue::overhead()
+{
+    return sizeof(_header_t);
+}
+
+uint16_t TileQueue::count()
+{
+    return _count;
+}
+
+void TileQueue::getStats(tile_queue_stats_t &stats)
+{
+    stats = _stats;
+    stats.count = _count;
+    stats.used = _used;
+    stats.size = _storage.size();
+}
+
+void TileQueue::resetStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+// drop messages according to policy until len bytes are available
+bool TileQueue::_makeRoom(uint32_t len, uint8_t priority)
+{
+    if (len > _storage.size()) {
+        return false;
+    }
+
+    while (_used + len > _storage.size()) {
+        uint32_t victim = 0;
+
+        if (_policy == TILE_DROP_NEWEST) {
+            return false;
+        } else if (_policy == TILE_DROP_PRIORITY) {
+            // find oldest message with lowest priority
+            _header_t hdr;
+            uint8_t lowest = 0xff;
+            uint32_t addr = 0;
+            while (addr < _used) {
+                _storage.read(addr, &hdr, sizeof(hdr));
+                if (hdr.priority < lowest) {
+                    lowest = hdr.priority;
+                    victim = addr;
+                }
+                addr += sizeof(hdr) + hdr.msg_len;
+            }
+            if (lowest > priority) {
+                // new message is least important
+                return false;
+            }
+        }
+
+        _remove(victim);
+        _stats.dropped++;
+    }
+
+    _peek_valid = false;
+    return true;
+}
+
+// remove record at addr and move following records down
+void TileQueue::_remove(uint32_t addr)
+{
+    uint8_t chunk[32];
+    uint32_t len = _recordSize(addr);
+    uint32_t src = addr + len;
+
+    while (src < _used) {
+        uint16_t n = sizeof(chunk);
+        if (_used - src < n) {
+            n = _used - src;
+        }
+        _storage.read(src, chunk, n);
+        _storage.write(src - len, chunk, n);
+        src += n;
+    }
+
+    _used -= len;
+    _count--;
+}
+
+uint32_t TileQueue::_recordSize(uint32_t addr)
+{
+    _header_t hdr;
+    _storage.read(addr, &hdr, sizeof(hdr));
+    return sizeof(hdr) + hdr.msg_len;
+}
@@ -0,0 +1,97 @@
+
+#ifndef TILEQUEUE_H
+#define TILEQUEUE_H
+
+#include "Arduino.h"
+#include "SwarmTile.h"
+
+typedef enum {
+    TILE_DROP_OLDEST = 0,       // drop oldest queued messages to make room for new message
+    TILE_DROP_NEWEST = 1,       // reject new message when queue is full
+    TILE_DROP_PRIORITY = 2      // drop oldest message with lowest priority, reject new message if it has lowest priority
+} tile_drop_policy_t;
+
+// remaining hold time of messages without hold time, sorts after all deadlines
+#define TILE_NO_DEADLINE 0xffffffff
+
+typedef struct {
+    // output
+    uint32_t queued;        // messages accepted into queue
+    uint32_t submitted;     // messages handed over to Tile
+    uint32_t dropped;       // queued messages dropped to make room, expired or rejected by Tile
+    uint32_t rejected;      // new messages rejected because queue was full
+    uint16_t count;         // messages currently in queue
+    uint32_t used;          // bytes currently used in storage
+    uint32_t size;          // size of storage in bytes
+} tile_queue_stats_t;
+
+// storage for queued messages, implement to keep messages e.g. in FRAM or EEPROM
+class TileQueueStorage
+{
+public:
+    virtual uint32_t size() = 0;    // number of bytes available to queue
+    virtual void read(uint32_t addr, void *buf, uint16_t len) = 0;
+    virtual void write(uint32_t addr, const void *buf, uint16_t len) = 0;
+};
+
+// storage for queued messages in a RAM buffer provided by the application
+class TileRamStorage : public TileQueueStorage
+{
+public:
+    TileRamStorage(void *buffer, uint32_t size);
+
+    virtual uint32_t size();
+    virtual void read(uint32_t addr, void *buf, uint16_t len);
+    virtual void write(uint32_t addr, const void *buf, uint16_t len);
+
+private:
+    uint8_t *_buffer;
+    uint32_t _size;
+};
+
+// queue for messages that can't be handed to the Tile yet, see SwarmTile::setOverflowQueue
+class TileQueue
+{
+public:
+    TileQueue(TileQueueStorage &storage, tile_drop_policy_t policy = TILE_DROP_OLDEST);
+
+    bool push(const tile_send_msg_t &msg);  // returns false if message was rejected
+    bool peek(tile_send_msg_t &msg, char *buf, uint16_t buf_len);   // next message to hand to Tile, by priority and deadline
+    void pop();             // remove message returned by peek after Tile accepted it
+    void discard();         // remove message returned by peek after it expired or Tile rejected it
+    void clear();
+    void setTime(uint32_t epoch);   // current UTC epoch, expiration times count as deadlines once set
+
+    uint16_t count();
+    static uint16_t overhead();     // storage bytes used per message in addition to its length
+    void getStats(tile_queue_stats_t &stats);
+    void resetStats();
+
+private:
+    TileQueueStorage &_storage;
+    tile_drop_policy_t _policy;
+
+    // header stored in front of each message
+    typedef struct {
+        uint16_t msg_len;
+        uint16_t app_id;
+        uint8_t priority;
+        uint32_t hold_time;
+        tile_datetime_t expiration;
+        uint32_t queued_ms;     // millis() when queued
+    } _header_t;
+
+    uint32_t _used;         // bytes used, records are packed from address 0
+    uint16_t _count;        // number of records
+    uint32_t _peek_addr;    // address of record returned by peek
+    bool _peek_valid;
+    tile_queue_stats_t _stats;
+    uint32_t _time_epoch;       // UTC epoch passed to setTime, 0 if unknown
+    unsigned long _time_ms;     // millis() when _time_epoch was set
+
+    bool _makeRoom(uint32_t len, uint8_t priority);
+    void _remove(uint32_t addr);
+    uint32_t _recordSize(uint32_t addr);
+};
+
+#endif
@@ -0,0 +1,39 @@
+
+#ifndef TILERING_H
+#define TILERING_H
+
+#include <inttypes.h>
+
+// fixed size ring of N entries, pushing to a full ring overwrites the oldest entry
+template <typename T, uint8_t N>
+class TileRing
+{
+public:
+    TileRing() : _head(0), _count(0) {}
+
+    void clear() { _head = 0; _count = 0; }
+    uint8_t count() const { return _count; }
+    uint8_t capacity() const { return N; }
+
+    // returns slot for a new entry, overwriting the oldest entry when full
+    T &push() {
+        T &slot = _items[_head];
+        _head = (_head + 1) % N;
+        if (_count < N) {
+            _count++;
+        }
+        return slot;
+    }
+    void push(const T &item) { push() = item; }
+
+    // access entries by age, index 0 is the newest entry
+    T &newest(uint8_t index = 0) { return _items[(_head + N - 1 - index) % N]; }
+    const T &newest(uint8_t index = 0) const { return _items[(_head + N - 1 - index) % N]; }
+
+private:
+    T _items[N];
+    uint8_t _head;      // index of next slot to write
+    uint8_t _count;     // number of valid entries
+};
+
+#endif